@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#include "arena.h"
+#include "memory.h"
+#include <string.h>
+
+union align {
+  long l;
+  double d;
+  void *p;
+};
+#define ALIGN_SIZE (sizeof(union align))
+#define ROUND_UP(n) (((n) + ALIGN_SIZE - 1) / ALIGN_SIZE * ALIGN_SIZE)
+
+struct arena_block {
+  struct arena_block *next;
+  size_t size;
+  size_t used;
+  union align data[1];
+};
+
+static struct arena_block *new_block(size_t size)
+{
+  struct arena_block *block = (struct arena_block *)
+      MEMORY_ALLOC_ARRAY(char, sizeof(struct arena_block) + size);
+
+  if (block == NULL)
+    return NULL;
+
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+  struct arena_block *block = a->head;
+  void *mem = NULL;
+
+  size = ROUND_UP(size);
+
+  if (block == NULL || block->size - block->used < size) {
+    if (size > ARENA_BLOCK_SIZE / 4) {
+      /* large requests get their own block behind the current one
+         so the space left in the current one is not wasted */
+      block = new_block(size);
+      if (block == NULL)
+        return NULL;
+
+      if (a->head == NULL) {
+        a->head = block;
+      } else {
+        block->next = a->head->next;
+        a->head->next = block;
+      }
+    } else {
+      block = new_block(ARENA_BLOCK_SIZE);
+      if (block == NULL)
+        return NULL;
+
+      block->next = a->head;
+      a->head = block;
+    }
+  }
+
+  mem = (char *) block->data + block->used;
+  block->used += size;
+  return mem;
+}
+
+char *arena_strndup(struct arena *a, const char *str, size_t len)
+{
+  char *dst = (char *) arena_alloc(a, len + 1);
+
+  if (dst == NULL)
+    return NULL;
+
+  memcpy(dst, str, len);
+  dst[len] = '\0';
+  return dst;
+}
+
+void arena_take(struct arena *dst, struct arena *src)
+{
+  struct arena_block *tail = src->head;
+
+  if (tail == NULL)
+    return;
+
+  while (tail->next != NULL) {
+    tail = tail->next;
+  }
+  /* dst keeps allocating from its own head */
+  if (dst->head == NULL) {
+    dst->head = src->head;
+  } else {
+    tail->next = dst->head->next;
+    dst->head->next = src->head;
+  }
+  src->head = NULL;
+}
+
+void arena_free(struct arena *a)
+{
+  struct arena_block *block = a->head;
+
+  while (block != NULL) {
+    struct arena_block *next = block->next;
+    MEMORY_FREE(block);
+    block = next;
+  }
+  a->head = NULL;
+}
@@ -0,0 +1,35 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* default bytes of each block */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct arena_block;
+
+/*
+  Bump allocator for data that lives as long as a compilation. Memory is
+  taken from a list of blocks and is only released all at once by
+  arena_free, so pointers into the arena never move.
+*/
+struct arena {
+  struct arena_block *head;
+};
+
+#define ARENA_INIT {NULL}
+
+/* returns size bytes aligned for any type, or NULL */
+extern void *arena_alloc(struct arena *a, size_t size);
+/* copies len characters of str and adds a null character */
+extern char *arena_strndup(struct arena *a, const char *str, size_t len);
+/* moves the blocks of src to dst leaving src empty */
+extern void arena_take(struct arena *dst, struct arena *src);
+extern void arena_free(struct arena *a);
+
+#endif /* XXX_H */
@@ -6,31 +6,127 @@ See LICENSE and README
 #include "ast.h"
 #include "memory.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 typedef struct ast_node node_t;
-static void print_node_recursive(const node_t *node, int depth);
-static void free_node_recursive(node_t *node);
+static void print_node(const node_t *node, enum ast_visit_order order, void *data);
 
-struct ast_node *new_node(int kind, struct ast_node *left, struct ast_node *right)
+struct ast_node *new_node(struct arena *nodes, int kind,
+    struct ast_node *left, struct ast_node *right)
 {
-  node_t *n = MEMORY_ALLOC(node_t);
+  node_t *n = (node_t *) arena_alloc(nodes, sizeof(node_t));
+  if (n == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
   n->kind = kind;
+  if (left != NULL) {
+    n->loc = left->loc;
+  } else if (right != NULL) {
+    n->loc = right->loc;
+  } else {
+    const struct location ini_loc = LOCATION_INIT;
+    n->loc = ini_loc;
+  }
   n->lnode = left;
   n->rnode = right;
+  n->value.symbol = NULL;
   return n;
 }
 
 void ast_print_tree(const struct ast_node *node)
 {
-  print_node_recursive(node, 0);
+  int depth = 0;
+
+  if (!ast_walk(node, print_node, &depth)) {
+    fprintf(stderr, "error: out of memory\n");
+  }
 }
 
-void ast_free_node(struct ast_node *node)
+/* enough for most trees without touching the heap */
+#define WALK_STACK_SIZE 256
+
+struct walk_frame {
+  const node_t *node;
+  enum ast_visit_order next;
+};
+
+int ast_walk(const struct ast_node *root, ast_visitor visit, void *data)
 {
-  free_node_recursive(node);
+  struct walk_frame local[WALK_STACK_SIZE];
+  struct walk_frame *stack = local;
+  int max = WALK_STACK_SIZE;
+  int n = 0;
+
+  if (root == NULL) {
+    return 1;
+  }
+  stack[n].node = root;
+  stack[n].next = AST_VISIT_PRE;
+  n++;
+
+  while (n > 0) {
+    struct walk_frame *top = &stack[n - 1];
+    const node_t *node = top->node;
+    const node_t *child = NULL;
+
+    switch (top->next) {
+    case AST_VISIT_PRE:
+      visit(node, AST_VISIT_PRE, data);
+      top->next = AST_VISIT_IN;
+      child = node->lnode;
+      break;
+
+    case AST_VISIT_IN:
+      visit(node, AST_VISIT_IN, data);
+      top->next = AST_VISIT_POST;
+      child = node->rnode;
+      break;
+
+    case AST_VISIT_POST:
+      visit(node, AST_VISIT_POST, data);
+      n--;
+      break;
+    }
+
+    if (child == NULL) {
+      continue;
+    }
+    if (n == max) {
+      const int new_max = max * 2;
+      struct walk_frame *new_stack = NULL;
+
+      if (stack == local) {
+        new_stack = MEMORY_ALLOC_ARRAY(struct walk_frame, new_max);
+        if (new_stack != NULL) {
+          memcpy(new_stack, local, sizeof(local));
+        }
+      } else {
+        new_stack = MEMORY_REALLOC_ARRAY(stack, struct walk_frame, new_max);
+      }
+      if (new_stack == NULL) {
+        if (stack != local) {
+          MEMORY_FREE(stack);
+        }
+        return 0;
+      }
+      stack = new_stack;
+      max = new_max;
+    }
+    stack[n].node = child;
+    stack[n].next = AST_VISIT_PRE;
+    n++;
+  }
+
+  if (stack != local) {
+    MEMORY_FREE(stack);
+  }
+  return 1;
 }
 
+/* indexed by ast kind */
 static const struct {
   int kind;
   const char *string;
@@ -40,16 +136,26 @@ static const struct {
 #undef T
   {0,""} /* for no-comma entry */
 };
+/* fails to compile when ast_table gets out of sync with the ast kinds */
+typedef char ast_table_covers_ast_kinds[
+    sizeof(ast_table)/sizeof(ast_table[0]) == AST_NUL + 1 ? 1 : -1];
 
-static void print_node_recursive(const node_t *node, int depth)
+static void print_node(const node_t *node, enum ast_visit_order order, void *data)
 {
+  int *depth = (int *) data;
   int i;
-  int next_depth = depth;
 
-  if (node == NULL) {
+  if (order == AST_VISIT_POST) {
+    if (node->kind != AST_LIST) {
+      (*depth)--;
+    }
+    return;
+  }
+  if (order != AST_VISIT_PRE) {
     return;
   }
-  for (i = 0; i < depth; i++) {
+
+  for (i = 0; i < *depth; i++) {
     if (i == 0) {
       printf("  |");
     } else {
@@ -60,6 +166,9 @@ static void print_node_recursive(const node_t *node, int depth)
   if (node->kind != AST_LIST) {
     switch (node->kind) {
     case AST_LITERAL:
+      printf("%s [%s]\n", ast_table[node->kind].string, node->value.constant->spelling);
+      break;
+
     case AST_SYMBOL:
       printf("%s [%s]\n", ast_table[node->kind].string, symbol_name(node->value.symbol));
       break;
@@ -68,21 +177,9 @@ static void print_node_recursive(const node_t *node, int depth)
       printf("%s\n", ast_table[node->kind].string);
       break;
     }
-    next_depth++;
+    /* children are printed one level deeper until the post visit */
+    (*depth)++;
   } else {
     printf("\n");
   }
-
-  print_node_recursive(node->lnode, next_depth);
-  print_node_recursive(node->rnode, next_depth);
-}
-
-void free_node_recursive(node_t *node)
-{
-  if (node == NULL) {
-    return;
-  }
-  free_node_recursive(node->lnode);
-  free_node_recursive(node->rnode);
-  MEMORY_FREE(node);
 }
@@ -6,7 +6,10 @@ See LICENSE and README
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
+#include "constant.h"
 #include "symbol.h"
+#include "token.h"
 
 #define AST_KIND_LIST(T) \
   T(AST_ASSIGN, "=") \
@@ -72,18 +75,40 @@ enum ast_kind {
 
 struct ast_node {
   int kind;
+  struct location loc;
   struct ast_node *lnode;
   struct ast_node *rnode;
 
   union {
     struct symbol *symbol;
+    /* AST_LITERAL and AST_STRING_LITERAL */
+    const struct constant *constant;
   } value;
 };
 
-#define NODE_INIT {0,NULL,NULL,{0}}
+#define NODE_INIT {0,LOCATION_INIT,NULL,NULL,{0}}
 
-extern struct ast_node *new_node(int kind, struct ast_node *left, struct ast_node *right);
+/* nodes are allocated from the arena and freed all at once with it.
+   a new node starts where its first child does until the parser sets
+   the location of the token that opens it */
+extern struct ast_node *new_node(struct arena *nodes, int kind,
+    struct ast_node *left, struct ast_node *right);
 extern void ast_print_tree(const struct ast_node *node);
-extern void ast_free_node(struct ast_node *node);
+
+/* when a visitor is called for a node */
+enum ast_visit_order {
+  AST_VISIT_PRE,  /* before the left subtree */
+  AST_VISIT_IN,   /* between the left and right subtrees */
+  AST_VISIT_POST  /* after the right subtree */
+};
+
+typedef void (*ast_visitor)(const struct ast_node *node,
+    enum ast_visit_order order, void *data);
+
+/* calls visit three times for every node in depth first order. the
+   pending nodes are kept on the heap rather than the call stack, so
+   the depth of a tree is not limited by the stack size.
+   returns 0 when out of memory, otherwise 1 */
+extern int ast_walk(const struct ast_node *root, ast_visitor visit, void *data);
 
 #endif /* XXX_H */
@@ -0,0 +1,318 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "cache.h"
+#include "memory.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define FNV_PRIME 1099511628211UL
+
+/* the files of one key, or one of them until merged */
+struct cache_entry {
+  char key[CACHE_KEY_SIZE];
+  unsigned long size;
+  /* the last time either file was used */
+  time_t mtime;
+};
+
+unsigned long cache_hash(unsigned long key, const void *data, size_t n)
+{
+  const unsigned char *p = (const unsigned char *) data;
+  const unsigned char *end = p + n;
+
+  while (p < end) {
+    key ^= *p++;
+    key *= FNV_PRIME;
+  }
+  return key;
+}
+
+unsigned long cache_hash_string(unsigned long key, const char *s)
+{
+  /* the null character keeps "ab","c" apart from "a","bc" */
+  return cache_hash(key, s, strlen(s) + 1);
+}
+
+/* joins dir and name with a slash in a new string, or NULL */
+static char *join_path(const char *dir, size_t dir_len, const char *name)
+{
+  char *path = MEMORY_ALLOC_ARRAY(char, dir_len + strlen(name) + 2);
+
+  if (path == NULL) {
+    return NULL;
+  }
+  memcpy(path, dir, dir_len);
+  path[dir_len] = '/';
+  strcpy(path + dir_len + 1, name);
+  return path;
+}
+
+/* a rebuilt or upgraded file changes its size or time */
+static unsigned long hash_file_identity(unsigned long key, const char *path)
+{
+  struct stat st;
+
+  key = cache_hash_string(key, path);
+  if (stat(path, &st) == 0) {
+    const unsigned long size = st.st_size;
+    const unsigned long mtime = st.st_mtime;
+
+    key = cache_hash(key, &size, sizeof(size));
+    key = cache_hash(key, &mtime, sizeof(mtime));
+  }
+  return key;
+}
+
+unsigned long cache_hash_program(unsigned long key, const char *program)
+{
+  const char *dirs = getenv("PATH");
+  const char *dir = dirs;
+
+  key = cache_hash_string(key, program);
+  /* a path is used as it is like the shell does */
+  if (strchr(program, '/') != NULL) {
+    dir = NULL;
+    key = hash_file_identity(key, program);
+  }
+  while (dir != NULL && *dir != '\0') {
+    const char *colon = strchr(dir, ':');
+    const size_t len = colon != NULL ? (size_t) (colon - dir) : strlen(dir);
+    char *path = join_path(dir, len, program);
+    struct stat st;
+
+    if (path != NULL && stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+        access(path, X_OK) == 0) {
+      key = hash_file_identity(key, path);
+      MEMORY_FREE(path);
+      break;
+    }
+    MEMORY_FREE(path);
+    dir = colon != NULL ? colon + 1 : NULL;
+  }
+  return key;
+}
+
+void cache_key_string(unsigned long key, char *str)
+{
+  static const char hex[] = "0123456789abcdef";
+  int i;
+
+  for (i = CACHE_KEY_SIZE - 2; i >= 0; i--) {
+    str[i] = hex[key & 0xf];
+    key >>= 4;
+  }
+  str[CACHE_KEY_SIZE - 1] = '\0';
+}
+
+int open_cache(struct cache *c, const char *dir, unsigned long max_bytes)
+{
+  struct stat st;
+
+  if (mkdir(dir, 0777) != 0 && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+    perror(dir);
+    return 0;
+  }
+  c->dir = MEMORY_ALLOC_ARRAY(char, strlen(dir) + 1);
+  if (c->dir == NULL) {
+    return 0;
+  }
+  strcpy(c->dir, dir);
+  c->max_bytes = max_bytes;
+  return 1;
+}
+
+void close_cache(struct cache *c)
+{
+  const struct cache ini_cache = CACHE_INIT;
+
+  MEMORY_FREE(c->dir);
+  *c = ini_cache;
+}
+
+char *cache_path(const struct cache *c, const char *key, const char *suffix)
+{
+  const size_t dir_len = strlen(c->dir);
+  char *path = MEMORY_ALLOC_ARRAY(char, dir_len + strlen(key) + strlen(suffix) + 2);
+
+  if (path == NULL) {
+    return NULL;
+  }
+  sprintf(path, "%s/%s%s", c->dir, key, suffix);
+  return path;
+}
+
+/* returns 1 when the file exists and sets its times to now */
+static int touch_entry(const struct cache *c, const char *key, const char *suffix)
+{
+  char *path = cache_path(c, key, suffix);
+  int found = 0;
+
+  if (path != NULL) {
+    found = utime(path, NULL) == 0;
+    MEMORY_FREE(path);
+  }
+  return found;
+}
+
+int cache_lookup(const struct cache *c, const char *key)
+{
+  return touch_entry(c, key, ".o") && touch_entry(c, key, ".c");
+}
+
+int cache_store(const struct cache *c, const char *key, const char *suffix,
+    const char *tmp_path)
+{
+  char *path = cache_path(c, key, suffix);
+  int ok = 0;
+
+  if (path != NULL) {
+    ok = rename(tmp_path, path) == 0;
+    MEMORY_FREE(path);
+  }
+  if (!ok) {
+    remove(tmp_path);
+  }
+  return ok;
+}
+
+/* returns 1 for <16 hex digits>.o and <16 hex digits>.c, otherwise 0.
+   anything else in the directory is not ours to remove */
+static int is_entry_name(const char *name)
+{
+  const int len = CACHE_KEY_SIZE - 1;
+  int i;
+
+  for (i = 0; i < len; i++) {
+    if (!(name[i] >= '0' && name[i] <= '9') && !(name[i] >= 'a' && name[i] <= 'f')) {
+      return 0;
+    }
+  }
+  return strcmp(name + len, ".o") == 0 || strcmp(name + len, ".c") == 0;
+}
+
+static int compare_key(const void *a, const void *b)
+{
+  const struct cache_entry *ea = (const struct cache_entry *) a;
+  const struct cache_entry *eb = (const struct cache_entry *) b;
+
+  return strcmp(ea->key, eb->key);
+}
+
+static int compare_mtime(const void *a, const void *b)
+{
+  const struct cache_entry *ea = (const struct cache_entry *) a;
+  const struct cache_entry *eb = (const struct cache_entry *) b;
+
+  if (ea->mtime != eb->mtime) {
+    return ea->mtime < eb->mtime ? -1 : 1;
+  }
+  return 0;
+}
+
+/* returns 1 when either file of the entry was removed, otherwise 0 */
+static int remove_entry(const struct cache *c, const char *key)
+{
+  static const char *const suffixes[] = {".o", ".c"};
+  int removed = 0;
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    char *path = cache_path(c, key, suffixes[i]);
+    if (path != NULL && remove(path) == 0) {
+      removed = 1;
+    }
+    MEMORY_FREE(path);
+  }
+  return removed;
+}
+
+void cache_evict(const struct cache *c)
+{
+  struct cache_entry *entries = NULL;
+  int n_entries = 0;
+  int max_entries = 0;
+  unsigned long total = 0;
+  struct dirent *ent = NULL;
+  DIR *dir = opendir(c->dir);
+  int i, j;
+
+  if (dir == NULL) {
+    return;
+  }
+
+  /* files being written by other builds have a suffix after .o or .c */
+  while ((ent = readdir(dir)) != NULL) {
+    struct stat st;
+    char *path = NULL;
+    int found = 0;
+
+    if (!is_entry_name(ent->d_name)) {
+      continue;
+    }
+    path = join_path(c->dir, strlen(c->dir), ent->d_name);
+    if (path == NULL) {
+      break;
+    }
+    found = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+    MEMORY_FREE(path);
+    if (!found) {
+      continue;
+    }
+    if (n_entries == max_entries) {
+      const int new_max = max_entries == 0 ? 256 : max_entries * 2;
+      struct cache_entry *new_entries =
+          MEMORY_REALLOC_ARRAY(entries, struct cache_entry, new_max);
+
+      if (new_entries == NULL) {
+        break;
+      }
+      entries = new_entries;
+      max_entries = new_max;
+    }
+    memcpy(entries[n_entries].key, ent->d_name, CACHE_KEY_SIZE - 1);
+    entries[n_entries].key[CACHE_KEY_SIZE - 1] = '\0';
+    entries[n_entries].size = st.st_size;
+    entries[n_entries].mtime = st.st_mtime;
+    total += st.st_size;
+    n_entries++;
+  }
+  closedir(dir);
+
+  if (total <= c->max_bytes) {
+    MEMORY_FREE(entries);
+    return;
+  }
+
+  /* merges the .o and .c of a key so they go together */
+  qsort(entries, n_entries, sizeof(entries[0]), compare_key);
+  for (i = 0, j = 0; i < n_entries; i++) {
+    if (j > 0 && strcmp(entries[j - 1].key, entries[i].key) == 0) {
+      entries[j - 1].size += entries[i].size;
+      if (entries[i].mtime > entries[j - 1].mtime) {
+        entries[j - 1].mtime = entries[i].mtime;
+      }
+    } else {
+      entries[j++] = entries[i];
+    }
+  }
+  n_entries = j;
+
+  qsort(entries, n_entries, sizeof(entries[0]), compare_mtime);
+  for (i = 0; i < n_entries && total > c->max_bytes; i++) {
+    if (remove_entry(c, entries[i].key)) {
+      total -= entries[i].size;
+    }
+  }
+  MEMORY_FREE(entries);
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+/*
+  On-disk cache of compilation results. An entry is a pair of files
+  <key>.o and <key>.c in the cache directory, where the key hashes
+  everything the object depends on. Entries are written under a
+  temporary name and renamed into place, so concurrent builds never
+  see half-written entries. Hits refresh the time of an entry and
+  eviction removes the least recently used entries first.
+*/
+struct cache {
+  char *dir;
+  /* eviction keeps the entries within this size */
+  unsigned long max_bytes;
+};
+
+#define CACHE_INIT {NULL,0}
+
+/* 64-bit FNV-1a where unsigned long is 64 bits */
+#define CACHE_KEY_INIT 14695981039346656037UL
+
+/* 16 hex digits and a null character */
+#define CACHE_KEY_SIZE 17
+
+extern unsigned long cache_hash(unsigned long key, const void *data, size_t n);
+extern unsigned long cache_hash_string(unsigned long key, const char *s);
+/* hashes the path, size and time of the program found in PATH */
+extern unsigned long cache_hash_program(unsigned long key, const char *program);
+extern void cache_key_string(unsigned long key, char *str);
+
+/* creates dir when missing. returns 0 on failure, otherwise 1 */
+extern int open_cache(struct cache *c, const char *dir, unsigned long max_bytes);
+extern void close_cache(struct cache *c);
+
+/* <dir>/<key><suffix> in a new string, or NULL */
+extern char *cache_path(const struct cache *c, const char *key, const char *suffix);
+/* returns 1 when the entry exists and marks it as used, otherwise 0 */
+extern int cache_lookup(const struct cache *c, const char *key);
+/* moves the file at tmp_path into the entry as <key><suffix> */
+extern int cache_store(const struct cache *c, const char *key, const char *suffix,
+    const char *tmp_path);
+/* removes the least recently used entries until the cache fits, both
+   files of an entry together. other files in dir are left alone */
+extern void cache_evict(const struct cache *c);
+
+#endif /* XXX_H */
@@ -7,6 +7,8 @@ See LICENSE and README
 #include "parser.h"
 #include "lexer.h"
 #include "ast.h"
+#include "emitter.h"
+#include "memory.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,12 +18,29 @@ See LICENSE and README
 typedef struct context context_t;
 typedef struct ast_node node_t;
 
-static void print_code_recursive(FILE *fp, const node_t *node, context_t *cxt);
+static int print_code(struct emitter *out, const node_t *node, context_t *cxt);
+static int print_string_constants(struct emitter *out, const node_t *node,
+    const struct constant_pool *consts);
 
+/* the code is built in memory and written with a single fwrite */
 void print_c_code(FILE *fp, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, "#include <stdio.h>\n");
-  print_code_recursive(fp, node, cxt);
+  struct emitter out = EMITTER_INIT;
+  const int ok = emit_c_code(&out, node, cxt);
+
+  if (!emitter_flush(&out, fp) || !ok) {
+    fprintf(stderr, "error: failed to write the generated code\n");
+  }
+  free_emitter(&out);
+}
+
+int emit_c_code(struct emitter *out, const node_t *node, context_t *cxt)
+{
+  EMIT_LITERAL(out, "#include <stdio.h>\n");
+  if (cxt->consts != NULL && !print_string_constants(out, node, cxt->consts)) {
+    return 0;
+  }
+  return print_code(out, node, cxt) && !out->failed;
 }
 
 /*
@@ -91,831 +110,1002 @@ int main(int argc, const char **argv)
 }
 */
 
-static void indent(FILE *fp, context_t *cxt)
+static void indent(struct emitter *out, context_t *cxt)
+{
+	emit_indent(out, cxt->depth);
+}
+
+/* \ooo for byte c */
+static void print_octal_escape(struct emitter *out, unsigned char c)
 {
-	int i;
-	for (i = 0; i < cxt->depth; i++) {
-		fprintf(fp, "  ");
+	char esc[4];
+
+	esc[0] = '\\';
+	esc[1] = '0' + (c >> 6);
+	esc[2] = '0' + ((c >> 3) & 7);
+	esc[3] = '0' + (c & 7);
+	emit_chars(out, esc, sizeof(esc));
+}
+
+static void print_char_literal(struct emitter *out, long c)
+{
+	emit_char(out, '\'');
+	if (c == '\'' || c == '\\') {
+		emit_char(out, '\\');
+		emit_char(out, (char) c);
+	} else if (isprint((int) c)) {
+		emit_char(out, (char) c);
+	} else {
+		print_octal_escape(out, (unsigned char) c);
 	}
+	emit_char(out, '\'');
+}
+
+/* string literals are decoded by the lexer so they are escaped again */
+static void print_string_literal(struct emitter *out, const char *str, size_t len)
+{
+	const char *s;
+
+	emit_char(out, '"');
+	for (s = str; s < str + len; s++) {
+		switch (*s) {
+		case '"':  EMIT_LITERAL(out, "\\\""); break;
+		case '\\': EMIT_LITERAL(out, "\\\\"); break;
+		case '\n': EMIT_LITERAL(out, "\\n"); break;
+		case '\t': EMIT_LITERAL(out, "\\t"); break;
+		case '\r': EMIT_LITERAL(out, "\\r"); break;
+		case '\v': EMIT_LITERAL(out, "\\v"); break;
+		case '\f': EMIT_LITERAL(out, "\\f"); break;
+		case '\b': EMIT_LITERAL(out, "\\b"); break;
+		case '\a': EMIT_LITERAL(out, "\\a"); break;
+		default:
+			if (isprint((unsigned char) *s)) {
+				emit_char(out, *s);
+			} else {
+				/* octal does not run into following hex digits */
+				print_octal_escape(out, (unsigned char) *s);
+			}
+			break;
+		}
+	}
+	emit_char(out, '"');
+}
+
+static int is_statement(int kind)
+{
+	switch (kind) {
+	case AST_EMPTY_STMT: case AST_EXPR_STMT: case AST_COMPOUND:
+	case AST_IF: case AST_SWITCH: case AST_CASE: case AST_DEFAULT:
+	case AST_FOR_INIT: case AST_WHILE: case AST_DO_WHILE:
+	case AST_BREAK: case AST_CONTINUE: case AST_GOTO: case AST_LABEL:
+	case AST_RETURN: case AST_VAR_DECL: case AST_VARDUMP:
+	case AST_FN_DEF: case AST_ENUM_DEF:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* maps the following C lines back to the .es line of stmt */
+static void print_line_directive(struct emitter *out, const node_t *stmt, context_t *cxt)
+{
+	if (stmt->loc.line == 0) {
+		return;
+	}
+	EMIT_LITERAL(out, "#line ");
+	emit_long(out, stmt->loc.line);
+	emit_char(out, ' ');
+	print_string_literal(out, cxt->source_name, strlen(cxt->source_name));
+	emit_char(out, '\n');
+}
+
+#define STRING_CONSTANT_PREFIX "es_string_"
+
+/* the string literal passed to print as the format, or NULL. it stays a
+   literal in the code so the C compiler can check it against printf */
+static const node_t *print_format_of(const node_t *call)
+{
+  const node_t *fn = call->lnode;
+  const node_t *arg = call->rnode;
+
+  if (fn != NULL && fn->kind == AST_SYMBOL &&
+      strcmp(symbol_name(fn->value.symbol), "print") == 0 &&
+      arg != NULL && arg->kind == AST_STRING_LITERAL) {
+    return arg;
+  }
+  return NULL;
+}
+
+struct string_uses {
+  const node_t *print_format;
+  /* by constant id, set for strings used other than as a print format */
+  char *as_value;
+};
+
+static void mark_string_values(const node_t *node, enum ast_visit_order order,
+    void *data)
+{
+  struct string_uses *uses = (struct string_uses *) data;
+
+  if (order != AST_VISIT_PRE) {
+    return;
+  }
+  /* calls come before their arguments */
+  if (node->kind == AST_CALL_EXPR) {
+    uses->print_format = print_format_of(node);
+  } else if (node->kind == AST_STRING_LITERAL && node != uses->print_format) {
+    uses->as_value[node->value.constant->id] = 1;
+  }
+}
+
+/* each distinct string literal used as a value becomes one array shared
+   by its uses. returns 0 when out of memory, otherwise 1 */
+static int print_string_constants(struct emitter *out, const node_t *node,
+    const struct constant_pool *consts)
+{
+  const int N = constant_count(consts);
+  struct string_uses uses;
+  int ok = 0;
+  int i;
+
+  if (N == 0) {
+    return 1;
+  }
+  uses.print_format = NULL;
+  uses.as_value = MEMORY_ALLOC_ARRAY(char, N);
+  if (uses.as_value == NULL) {
+    return 0;
+  }
+  memset(uses.as_value, 0, N);
+  ok = ast_walk(node, mark_string_values, &uses);
+
+  for (i = 0; ok && i < N; i++) {
+    const struct constant *c = constant_at(consts, i);
+    if (c->kind != TYPE_STRING || !uses.as_value[c->id]) {
+      continue;
+    }
+    EMIT_LITERAL(out, "static const char " STRING_CONSTANT_PREFIX);
+    emit_long(out, c->id);
+    EMIT_LITERAL(out, "[] = ");
+    print_string_literal(out, c->spelling, c->length);
+    EMIT_LITERAL(out, ";\n");
+  }
+  MEMORY_FREE(uses.as_value);
+  return ok;
 }
 
 /* AST_POST_INC */
-static void AST_POST_INC_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_INC_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "((");
+	EMIT_LITERAL(out, "((");
 }
-static void AST_POST_INC_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_INC_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_POST_INC_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_INC_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")++)");
+	EMIT_LITERAL(out, ")++)");
 }
 
 /* AST_POST_DEC */
-static void AST_POST_DEC_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_DEC_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "((");
+	EMIT_LITERAL(out, "((");
 }
-static void AST_POST_DEC_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_DEC_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_POST_DEC_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_POST_DEC_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")--)");
+	EMIT_LITERAL(out, ")--)");
 }
 
 /* AST_PRE_INC */
-static void AST_PRE_INC_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_INC_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_PRE_INC_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_INC_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "++(");
+	EMIT_LITERAL(out, "++(");
 }
-static void AST_PRE_INC_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_INC_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "))");
+	EMIT_LITERAL(out, "))");
 }
 
 /* AST_PRE_DEC */
-static void AST_PRE_DEC_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_DEC_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_PRE_DEC_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_DEC_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "--(");
+	EMIT_LITERAL(out, "--(");
 }
-static void AST_PRE_DEC_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_PRE_DEC_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "))");
+	EMIT_LITERAL(out, "))");
 }
 
 /* AST_LSHIFT */
-static void AST_LSHIFT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LSHIFT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_LSHIFT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LSHIFT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " << ");
+	EMIT_LITERAL(out, " << ");
 }
-static void AST_LSHIFT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LSHIFT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_RSHIFT */
-static void AST_RSHIFT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RSHIFT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_RSHIFT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RSHIFT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " >> ");
+	EMIT_LITERAL(out, " >> ");
 }
-static void AST_RSHIFT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RSHIFT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_LT */
-static void AST_LT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_LT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " < ");
+	EMIT_LITERAL(out, " < ");
 }
-static void AST_LT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_GT */
-static void AST_GT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_GT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " > ");
+	EMIT_LITERAL(out, " > ");
 }
-static void AST_GT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_LE */
-static void AST_LE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_LE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " <= ");
+	EMIT_LITERAL(out, " <= ");
 }
-static void AST_LE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_GE */
-static void AST_GE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_GE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " >= ");
+	EMIT_LITERAL(out, " >= ");
 }
-static void AST_GE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_EQ */
-static void AST_EQ_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EQ_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, "(");
+  EMIT_LITERAL(out, "(");
 }
-static void AST_EQ_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EQ_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " == ");
+	EMIT_LITERAL(out, " == ");
 }
-static void AST_EQ_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EQ_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, ")");
+  EMIT_LITERAL(out, ")");
 }
 
 /* AST_NE */
-static void AST_NE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_NE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_NE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_NE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " != ");
+	EMIT_LITERAL(out, " != ");
 }
-static void AST_NE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_NE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_BITWISE_AND */
-static void AST_BITWISE_AND_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_AND_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_BITWISE_AND_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_AND_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " & ");
+	EMIT_LITERAL(out, " & ");
 }
-static void AST_BITWISE_AND_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_AND_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_BITWISE_XOR */
-static void AST_BITWISE_XOR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_XOR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_BITWISE_XOR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_XOR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " ^ ");
+	EMIT_LITERAL(out, " ^ ");
 }
-static void AST_BITWISE_XOR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_XOR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_BITWISE_OR */
-static void AST_BITWISE_OR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_OR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_BITWISE_OR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_OR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " | ");
+	EMIT_LITERAL(out, " | ");
 }
-static void AST_BITWISE_OR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BITWISE_OR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_OR */
-static void AST_OR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_OR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_OR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_OR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " || ");
+	EMIT_LITERAL(out, " || ");
 }
-static void AST_OR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_OR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_AND */
-static void AST_AND_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_AND_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_AND_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_AND_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " && ");
+	EMIT_LITERAL(out, " && ");
 }
-static void AST_AND_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_AND_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_ADD */
-static void AST_ADD_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ADD_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_ADD_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ADD_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " + ");
+	EMIT_LITERAL(out, " + ");
 }
-static void AST_ADD_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ADD_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_SUB */
-static void AST_SUB_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUB_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_SUB_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUB_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " - ");
+	EMIT_LITERAL(out, " - ");
 }
-static void AST_SUB_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUB_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_MUL */
-static void AST_MUL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MUL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_MUL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MUL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " * ");
+	EMIT_LITERAL(out, " * ");
 }
-static void AST_MUL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MUL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_DIV */
-static void AST_DIV_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DIV_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_DIV_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DIV_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " / ");
+	EMIT_LITERAL(out, " / ");
 }
-static void AST_DIV_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DIV_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_MOD */
-static void AST_MOD_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MOD_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_MOD_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MOD_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " %% ");
+	EMIT_LITERAL(out, " % ");
 }
-static void AST_MOD_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_MOD_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_ASSIGN */
-static void AST_ASSIGN_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ASSIGN_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
 }
-static void AST_ASSIGN_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ASSIGN_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " = ");
+	EMIT_LITERAL(out, " = ");
 }
-static void AST_ASSIGN_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ASSIGN_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_CALL_EXPR */
-static void AST_CALL_EXPR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CALL_EXPR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
+  cxt->print_format = print_format_of(node);
 }
-static void AST_CALL_EXPR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CALL_EXPR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, "(");
+  EMIT_LITERAL(out, "(");
 }
-static void AST_CALL_EXPR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CALL_EXPR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")");
+	EMIT_LITERAL(out, ")");
 }
 
 /* AST_SUBSCRIPT_EXPR */
-static void AST_SUBSCRIPT_EXPR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUBSCRIPT_EXPR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_SUBSCRIPT_EXPR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUBSCRIPT_EXPR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, "[");
+  EMIT_LITERAL(out, "[");
 }
-static void AST_SUBSCRIPT_EXPR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SUBSCRIPT_EXPR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "]");
+	EMIT_LITERAL(out, "]");
 }
 
 /* AST_FN_DEF */
-static void AST_FN_DEF_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_DEF_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "int ");
+	EMIT_LITERAL(out, "int ");
 }
-static void AST_FN_DEF_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_DEF_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   /*
-	fprintf(fp, "(void)\n");
+	EMIT_LITERAL(out, "(void)\n");
   */
 }
-static void AST_FN_DEF_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_DEF_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_FN_BODY */
-static void AST_FN_BODY_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_BODY_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "(");
+	EMIT_LITERAL(out, "(");
   if (node->lnode == NULL) {
-    fprintf(fp, "void");
+    EMIT_LITERAL(out, "void");
   }
 }
-static void AST_FN_BODY_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_BODY_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")\n");
+	EMIT_LITERAL(out, ")\n");
 }
-static void AST_FN_BODY_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FN_BODY_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_ENUM_DEF */
-static void AST_ENUM_DEF_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUM_DEF_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "enum ");
+	EMIT_LITERAL(out, "enum ");
 }
-static void AST_ENUM_DEF_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUM_DEF_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, " {\n");
+	EMIT_LITERAL(out, " {\n");
   cxt->is_inside_enum_def = 1;
   cxt->depth++;
 }
-static void AST_ENUM_DEF_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUM_DEF_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, "};\n");
+	EMIT_LITERAL(out, "};\n");
   cxt->is_inside_enum_def = 0;
   cxt->depth--;
 }
 
 /* AST_ENUMERATOR */
-static void AST_ENUMERATOR_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUMERATOR_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_ENUMERATOR_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUMERATOR_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL) {
-    fprintf(fp, " = ");
+    EMIT_LITERAL(out, " = ");
   }
 }
-static void AST_ENUMERATOR_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_ENUMERATOR_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_LIST */
-static void AST_LIST_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LIST_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (cxt->is_inside_enum_def) {
-    indent(fp, cxt);
+    indent(out, cxt);
+  }
+  /* statements in a list start on a new line so a directive fits there */
+  else if (cxt->source_name != NULL && node->lnode != NULL &&
+      is_statement(node->lnode->kind)) {
+    print_line_directive(out, node->lnode, cxt);
   }
 }
-static void AST_LIST_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LIST_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (cxt->is_inside_enum_def) {
     if (node->rnode != NULL) {
-      fprintf(fp, ",");
+      EMIT_LITERAL(out, ",");
     }
-    fprintf(fp, "\n");
+    EMIT_LITERAL(out, "\n");
   }
   else if (cxt->is_inside_initializer) {
     if (node->rnode != NULL) {
-      fprintf(fp, ", ");
+      EMIT_LITERAL(out, ", ");
     }
   }
 }
-static void AST_LIST_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LIST_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_LITERAL */
-static void AST_LITERAL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LITERAL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  const char *literal = symbol_name(node->value.symbol);
-  if (isalpha(literal[0]) && literal[1] == '\0') {
-    fprintf(fp, "'%s'", literal);
+  const struct constant *c = node->value.constant;
+  if (c->kind == TYPE_CHAR) {
+    print_char_literal(out, c->value.Integer);
   } else {
-    fprintf(fp, "%s", literal);
+    emit_str(out, c->spelling);
   }
 }
-static void AST_LITERAL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LITERAL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_LITERAL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LITERAL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_STRING_LITERAL */
-static void AST_STRING_LITERAL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_STRING_LITERAL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, "\"%s\"", symbol_name(node->value.symbol));
+  const struct constant *c = node->value.constant;
+  if (cxt->consts != NULL && node != cxt->print_format) {
+    EMIT_LITERAL(out, STRING_CONSTANT_PREFIX);
+    emit_long(out, c->id);
+  } else {
+    print_string_literal(out, c->spelling, c->length);
+  }
 }
-static void AST_STRING_LITERAL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_STRING_LITERAL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_STRING_LITERAL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_STRING_LITERAL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_EMPTY_STMT */
-static void AST_EMPTY_STMT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EMPTY_STMT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
+  indent(out, cxt);
 }
-static void AST_EMPTY_STMT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EMPTY_STMT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_EMPTY_STMT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EMPTY_STMT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_EXPR_STMT */
-static void AST_EXPR_STMT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EXPR_STMT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
+  indent(out, cxt);
 }
-static void AST_EXPR_STMT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EXPR_STMT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_EXPR_STMT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_EXPR_STMT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_COMPOUND */
-static void AST_COMPOUND_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_COMPOUND_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "{\n");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "{\n");
   cxt->depth++;
 }
-static void AST_COMPOUND_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_COMPOUND_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_COMPOUND_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_COMPOUND_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   cxt->depth--;
-  indent(fp, cxt);
-	fprintf(fp, "}\n");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "}\n");
 }
 
 /* AST_BREAK */
-static void AST_BREAK_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BREAK_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "break");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "break");
 }
-static void AST_BREAK_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BREAK_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_BREAK_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_BREAK_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_CONTINUE */
-static void AST_CONTINUE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CONTINUE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "continue");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "continue");
 }
-static void AST_CONTINUE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CONTINUE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_CONTINUE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CONTINUE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_IF */
-static void AST_IF_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_IF_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "if (");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "if (");
 }
-static void AST_IF_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_IF_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-  fprintf(fp, ") ");
+  indent(out, cxt);
+  EMIT_LITERAL(out, ") ");
 }
-static void AST_IF_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_IF_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_THEN */
-static void AST_THEN_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_THEN_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_THEN_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_THEN_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL) {
-    indent(fp, cxt);
-    fprintf(fp, "else\n");
+    indent(out, cxt);
+    EMIT_LITERAL(out, "else\n");
   }
 }
-static void AST_THEN_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_THEN_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_SWITCH */
-static void AST_SWITCH_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SWITCH_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "switch (");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "switch (");
 }
-static void AST_SWITCH_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SWITCH_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  fprintf(fp, ")\n");
+  EMIT_LITERAL(out, ")\n");
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_pre_code(fp, node, cxt);
+    AST_COMPOUND_pre_code(out, node, cxt);
   }
 }
-static void AST_SWITCH_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SWITCH_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_post_code(fp, node, cxt);
+    AST_COMPOUND_post_code(out, node, cxt);
   }
 }
 
 /* AST_CASE */
-static void AST_CASE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CASE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   cxt->depth--;
-  indent(fp, cxt);
-  fprintf(fp, "case ");
+  indent(out, cxt);
+  EMIT_LITERAL(out, "case ");
   cxt->depth++;
 }
-static void AST_CASE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CASE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ":\n");
+	EMIT_LITERAL(out, ":\n");
 }
-static void AST_CASE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_CASE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_DEFAULT */
-static void AST_DEFAULT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DEFAULT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   cxt->depth--;
-  indent(fp, cxt);
-  fprintf(fp, "default:");
+  indent(out, cxt);
+  EMIT_LITERAL(out, "default:");
   cxt->depth++;
 }
-static void AST_DEFAULT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DEFAULT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_DEFAULT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DEFAULT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "break;\n");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "break;\n");
 }
 
 /* AST_FOR_INIT */
-static void AST_FOR_INIT_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_INIT_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "for (");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "for (");
 }
-static void AST_FOR_INIT_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_INIT_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   /*
-	fprintf(fp, "; ");
+	EMIT_LITERAL(out, "; ");
   */
 }
-static void AST_FOR_INIT_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_INIT_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_FOR_COND */
-static void AST_FOR_COND_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_COND_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_FOR_COND_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_COND_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   /*
-	fprintf(fp, "; ");
+	EMIT_LITERAL(out, "; ");
   */
 }
-static void AST_FOR_COND_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_COND_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_FOR_BODY */
-static void AST_FOR_BODY_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_BODY_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_FOR_BODY_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_BODY_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")\n");
+	EMIT_LITERAL(out, ")\n");
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_pre_code(fp, node, cxt);
+    AST_COMPOUND_pre_code(out, node, cxt);
   }
 }
-static void AST_FOR_BODY_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_FOR_BODY_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_post_code(fp, node, cxt);
+    AST_COMPOUND_post_code(out, node, cxt);
   }
 }
 
 /* AST_WHILE */
-static void AST_WHILE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_WHILE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "while (");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "while (");
 }
-static void AST_WHILE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_WHILE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ")\n");
+	EMIT_LITERAL(out, ")\n");
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_pre_code(fp, node, cxt);
+    AST_COMPOUND_pre_code(out, node, cxt);
   }
 }
-static void AST_WHILE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_WHILE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL && node->rnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_post_code(fp, node, cxt);
+    AST_COMPOUND_post_code(out, node, cxt);
   }
 }
 
 /* AST_DO_WHILE */
-static void AST_DO_WHILE_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DO_WHILE_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "do\n");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "do\n");
   if (node->rnode != NULL && node->lnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_pre_code(fp, node, cxt);
+    AST_COMPOUND_pre_code(out, node, cxt);
   }
 }
-static void AST_DO_WHILE_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DO_WHILE_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   if (node->rnode != NULL && node->lnode->kind != AST_COMPOUND) {
-    AST_COMPOUND_post_code(fp, node, cxt);
+    AST_COMPOUND_post_code(out, node, cxt);
   }
-  indent(fp, cxt);
-	fprintf(fp, "while (");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "while (");
 }
-static void AST_DO_WHILE_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_DO_WHILE_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ");\n");
+	EMIT_LITERAL(out, ");\n");
 }
 
 /* AST_RETURN */
-static void AST_RETURN_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RETURN_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "return ");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "return ");
 }
-static void AST_RETURN_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RETURN_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_RETURN_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_RETURN_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_GOTO */
-static void AST_GOTO_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GOTO_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-	fprintf(fp, "goto ");
+  indent(out, cxt);
+	EMIT_LITERAL(out, "goto ");
 }
-static void AST_GOTO_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GOTO_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
-static void AST_GOTO_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_GOTO_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_LABEL */
-static void AST_LABEL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LABEL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   cxt->depth--;
-  indent(fp, cxt);
+  indent(out, cxt);
   cxt->depth++;
 }
-static void AST_LABEL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LABEL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-	fprintf(fp, ":\n");
+	EMIT_LITERAL(out, ":\n");
 }
-static void AST_LABEL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_LABEL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_SYMBOL */
-static void AST_SYMBOL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SYMBOL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 	if (strcmp(symbol_name(node->value.symbol), "print") == 0) {
-		fprintf(fp, "printf");
+		EMIT_LITERAL(out, "printf");
 	} else {
-    fprintf(fp, "%s", symbol_name(node->value.symbol));
+    emit_str(out, symbol_name(node->value.symbol));
 	}
 }
-static void AST_SYMBOL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SYMBOL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_SYMBOL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_SYMBOL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
 
 /* AST_VAR_DECL */
-static void AST_VAR_DECL_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VAR_DECL_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   node_t *idnt = node->lnode;
   const struct type_info type = symbol_type(idnt->value.symbol);
 
-  indent(fp, cxt);
+  indent(out, cxt);
   if (type.kind == TYPE_BOOL) {
-    fprintf(fp, "char ");
+    EMIT_LITERAL(out, "char ");
   } else if (type.kind == TYPE_STRING) {
-    fprintf(fp, "char *");
+    EMIT_LITERAL(out, "const char *");
   } else {
-    fprintf(fp, "%s ", type_to_string(type.kind));
+    emit_str(out, type_to_string(type.kind));
+    emit_char(out, ' ');
   }
 }
-static void AST_VAR_DECL_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VAR_DECL_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   node_t *idnt = node->lnode;
   const struct type_info type = symbol_type(idnt->value.symbol);
   if (type.is_array) {
-    fprintf(fp, "[%lu]", type.array_size);
+    emit_char(out, '[');
+    emit_ulong(out, type.array_size);
+    emit_char(out, ']');
   }
 
-	fprintf(fp, " = ");
+	EMIT_LITERAL(out, " = ");
 
   if (type.is_array) {
-    fprintf(fp, "{");
+    EMIT_LITERAL(out, "{");
     cxt->is_inside_initializer = 1;
   }
 }
-static void AST_VAR_DECL_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VAR_DECL_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   node_t *idnt = node->lnode;
   const struct type_info type = symbol_type(idnt->value.symbol);
   if (type.is_array) {
-    fprintf(fp, "}");
+    EMIT_LITERAL(out, "}");
     cxt->is_inside_initializer = 0;
   }
-	fprintf(fp, ";\n");
+	EMIT_LITERAL(out, ";\n");
 }
 
 /* AST_VARDUMP */
-static void AST_VARDUMP_pre_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VARDUMP_pre_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
-  indent(fp, cxt);
-  fprintf(fp, "printf(\"#  ");
+  indent(out, cxt);
+  EMIT_LITERAL(out, "printf(\"#  ");
 }
-static void AST_VARDUMP_in_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VARDUMP_in_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
 }
-static void AST_VARDUMP_post_code(FILE *fp, const node_t *node, context_t *cxt)
+static void AST_VARDUMP_post_code(struct emitter *out, const node_t *node, context_t *cxt)
 {
   node_t *idnt = node->lnode;
   const struct type_info type = symbol_type(idnt->value.symbol);
@@ -923,11 +1113,15 @@ static void AST_VARDUMP_post_code(FILE *fp, const node_t *node, context_t *cxt)
   const char *spec = "";
   switch (type.kind) {
   case TYPE_CHAR:
-    fprintf(fp, " => '%%c' (char)\\n\", %s);\n", name);
+    EMIT_LITERAL(out, " => '%c' (char)\\n\", ");
+    emit_str(out, name);
+    EMIT_LITERAL(out, ");\n");
     return;
     break;
   case TYPE_BOOL:
-    fprintf(fp, " => %%s (bool)\\n\", %s==0?\"false\":\"true\");\n", name);
+    EMIT_LITERAL(out, " => %s (bool)\\n\", ");
+    emit_str(out, name);
+    EMIT_LITERAL(out, "==0?\"false\":\"true\");\n");
     return;
     break;
   case TYPE_SHORT:
@@ -936,58 +1130,71 @@ static void AST_VARDUMP_post_code(FILE *fp, const node_t *node, context_t *cxt)
   case TYPE_FLOAT:
   case TYPE_DOUBLE: spec = "%g"; break;
   case TYPE_STRING:
-    fprintf(fp, " => \\\"%%s\\\" (string)\\n\", %s);\n", name);
+    EMIT_LITERAL(out, " => \\\"%s\\\" (string)\\n\", ");
+    emit_str(out, name);
+    EMIT_LITERAL(out, ");\n");
     return;
     break;
   default: break;
   }
-  fprintf(fp, " => %s (%s)\\n\", %s);\n", spec, type_to_string(type.kind), name);
+  EMIT_LITERAL(out, " => ");
+  emit_str(out, spec);
+  EMIT_LITERAL(out, " (");
+  emit_str(out, type_to_string(type.kind));
+  EMIT_LITERAL(out, ")\\n\", ");
+  emit_str(out, name);
+  EMIT_LITERAL(out, ");\n");
 }
 
-typedef void (*WriteCode)(FILE *fp, const node_t *node, context_t *cxt);
+typedef void (*WriteCode)(struct emitter *out, const node_t *node, context_t *cxt);
 typedef struct ccode {
-	int ast_node_op;
 	WriteCode write_pre_code;
 	WriteCode write_in_code;
 	WriteCode write_post_code;
 } ccode_t;
+/* indexed by ast kind */
 static const ccode_t ccodes[] = {
-#define T(tag, str) {tag, tag##_pre_code, tag##_in_code, tag##_post_code},
+#define T(tag, str) {tag##_pre_code, tag##_in_code, tag##_post_code},
   AST_KIND_LIST(T)
 #undef T
-  {0, NULL, NULL, NULL}
 };
-static const int N_CCODES = sizeof(ccodes)/sizeof(ccodes[0]);
+/* fails to compile when ccodes gets out of sync with the ast kinds */
+typedef char ccodes_cover_ast_kinds[
+    sizeof(ccodes)/sizeof(ccodes[0]) == AST_NUL ? 1 : -1];
 
-static void print_code_recursive(FILE *fp, const node_t *node, context_t *cxt)
+struct code_writer {
+	struct emitter *out;
+	context_t *cxt;
+};
+
+static void write_code(const node_t *node, enum ast_visit_order order, void *data)
 {
+	const struct code_writer *w = (const struct code_writer *) data;
 	const ccode_t *ccode = NULL;
-	int i;
 
-	if (node == NULL) {
+	if (node->kind < 0 || node->kind >= AST_NUL) {
 		return;
 	}
+	ccode = &ccodes[node->kind];
 
-	for (i = 0; i < N_CCODES; i++) {
-		if (ccodes[i].ast_node_op == node->kind) {
-			ccode = &ccodes[i];
-			break;
-		}
-	}
-
-	if (ccode != NULL) {
-		ccode->write_pre_code(fp, node, cxt);
-	}
-
-	print_code_recursive(fp, node->lnode, cxt);
-
-	if (ccode != NULL) {
-		ccode->write_in_code(fp, node, cxt);
+	switch (order) {
+	case AST_VISIT_PRE:
+		ccode->write_pre_code(w->out, node, w->cxt);
+		break;
+	case AST_VISIT_IN:
+		ccode->write_in_code(w->out, node, w->cxt);
+		break;
+	case AST_VISIT_POST:
+		ccode->write_post_code(w->out, node, w->cxt);
+		break;
 	}
+}
 
-	print_code_recursive(fp, node->rnode, cxt);
+static int print_code(struct emitter *out, const node_t *node, context_t *cxt)
+{
+	struct code_writer w;
 
-	if (ccode != NULL) {
-		ccode->write_post_code(fp, node, cxt);
-	}
+	w.out = out;
+	w.cxt = cxt;
+	return ast_walk(node, write_code, &w);
 }
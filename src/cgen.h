@@ -8,15 +8,26 @@ See LICENSE and README
 
 #include <stdio.h>
 
+struct constant_pool;
+
 struct context {
   int depth;
   int is_inside_enum_def;
   int is_inside_initializer;
+  /* string constants are emitted from here ahead of the code */
+  const struct constant_pool *consts;
+  /* when set, statements are preceded by #line directives naming this file */
+  const char *source_name;
+  /* the format of the print call being emitted, which stays inline */
+  const struct ast_node *print_format;
 };
-#define INIT_CONTEXT {0, 0, 0};
+#define INIT_CONTEXT {0, 0, 0, NULL, NULL, NULL};
 
 struct ast_node;
+struct emitter;
 
 extern void print_c_code(FILE *fp, const struct ast_node *node, struct context *cxt);
+/* appends the C code to out. returns 0 when out of memory, otherwise 1 */
+extern int emit_c_code(struct emitter *out, const struct ast_node *node, struct context *cxt);
 
 #endif /* XXX_H */
@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#include "constant.h"
+#include "arena.h"
+#include "intern.h"
+#include "memory.h"
+
+/* a power of two */
+#define INITIAL_CAPACITY 256
+
+struct constant_pool {
+  /* constants by spelling and kind. a slot is empty when NULL */
+  struct constant **slots;
+  unsigned long capacity;
+  /* constants by id */
+  struct constant **items;
+  int count;
+  int max_items;
+  struct arena arena;
+};
+
+static unsigned long hash_constant(const char *spelling, int kind)
+{
+  return intern_hash(spelling) ^ kind;
+}
+
+static struct constant **find_slot(const struct constant_pool *pool,
+    const char *spelling, int kind)
+{
+  const unsigned long mask = pool->capacity - 1;
+  unsigned long i = hash_constant(spelling, kind) & mask;
+
+  for (;;) {
+    struct constant **slot = &pool->slots[i];
+
+    if (*slot == NULL ||
+        ((*slot)->spelling == spelling && (*slot)->kind == kind)) {
+      return slot;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+static int grow_pool(struct constant_pool *pool)
+{
+  const unsigned long new_capacity = pool->capacity * 2;
+  struct constant **new_slots = MEMORY_ALLOC_ARRAY(struct constant *, new_capacity);
+  unsigned long i;
+
+  if (new_slots == NULL) {
+    return 0;
+  }
+  for (i = 0; i < new_capacity; i++) {
+    new_slots[i] = NULL;
+  }
+
+  MEMORY_FREE(pool->slots);
+  pool->slots = new_slots;
+  pool->capacity = new_capacity;
+
+  /* the items know every constant so they rebuild the slots */
+  for (i = 0; i < (unsigned long) pool->count; i++) {
+    const struct constant *c = pool->items[i];
+    *find_slot(pool, c->spelling, c->kind) = pool->items[i];
+  }
+  return 1;
+}
+
+struct constant_pool *new_constant_pool(void)
+{
+  struct constant_pool *pool = MEMORY_ALLOC(struct constant_pool);
+  const struct arena ini_arena = ARENA_INIT;
+  unsigned long i;
+
+  if (pool == NULL) {
+    return NULL;
+  }
+  pool->slots = MEMORY_ALLOC_ARRAY(struct constant *, INITIAL_CAPACITY);
+  if (pool->slots == NULL) {
+    MEMORY_FREE(pool);
+    return NULL;
+  }
+  for (i = 0; i < INITIAL_CAPACITY; i++) {
+    pool->slots[i] = NULL;
+  }
+  pool->capacity = INITIAL_CAPACITY;
+  pool->items = NULL;
+  pool->count = 0;
+  pool->max_items = 0;
+  pool->arena = ini_arena;
+  return pool;
+}
+
+void free_constant_pool(struct constant_pool *pool)
+{
+  if (pool == NULL) {
+    return;
+  }
+  arena_free(&pool->arena);
+  MEMORY_FREE(pool->slots);
+  MEMORY_FREE(pool->items);
+  MEMORY_FREE(pool);
+}
+
+const struct constant *add_constant(struct constant_pool *pool,
+    const struct constant *c)
+{
+  struct constant **slot = find_slot(pool, c->spelling, c->kind);
+  struct constant *new_const = NULL;
+
+  if (*slot != NULL) {
+    return *slot;
+  }
+
+  /* keeps the slots at most half full */
+  if ((unsigned long) (pool->count + 1) * 2 > pool->capacity) {
+    if (!grow_pool(pool)) {
+      return NULL;
+    }
+    slot = find_slot(pool, c->spelling, c->kind);
+  }
+
+  if (pool->count == pool->max_items) {
+    const int new_max = pool->max_items == 0 ? 64 : pool->max_items * 2;
+    struct constant **new_items =
+        MEMORY_REALLOC_ARRAY(pool->items, struct constant *, new_max);
+
+    if (new_items == NULL) {
+      return NULL;
+    }
+    pool->items = new_items;
+    pool->max_items = new_max;
+  }
+
+  new_const = (struct constant *) arena_alloc(&pool->arena, sizeof(struct constant));
+  if (new_const == NULL) {
+    return NULL;
+  }
+  *new_const = *c;
+  new_const->id = pool->count;
+
+  pool->items[pool->count++] = new_const;
+  *slot = new_const;
+  return new_const;
+}
+
+int constant_count(const struct constant_pool *pool)
+{
+  return pool->count;
+}
+
+const struct constant *constant_at(const struct constant_pool *pool, int id)
+{
+  return pool->items[id];
+}
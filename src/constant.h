@@ -0,0 +1,42 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef CONSTANT_H
+#define CONSTANT_H
+
+/*
+  Literals of a compilation, one entry per distinct spelling and type.
+  Kept apart from the symbol table so literals never mix with names.
+*/
+struct constant {
+  /* order of first appearance from 0 */
+  int id;
+  /* TYPE_INT, TYPE_LONG, TYPE_FLOAT, TYPE_DOUBLE, TYPE_CHAR or TYPE_STRING */
+  int kind;
+  /* interned. the source spelling of numbers, the decoded text of strings */
+  const char *spelling;
+  /* characters in spelling. strings may hold null characters */
+  int length;
+  union {
+    long Integer;
+    double Float;
+  } value;
+};
+
+struct constant_pool;
+
+extern struct constant_pool *new_constant_pool(void);
+extern void free_constant_pool(struct constant_pool *pool);
+
+/* returns the pooled constant equal to c by spelling and kind, adding a
+   copy of c when there is none, or NULL. the id of c is ignored */
+extern const struct constant *add_constant(struct constant_pool *pool,
+    const struct constant *c);
+
+/* constants by id */
+extern int constant_count(const struct constant_pool *pool);
+extern const struct constant *constant_at(const struct constant_pool *pool, int id);
+
+#endif /* XXX_H */
@@ -3,65 +3,723 @@ Copyright (c) 2012-2015 Hiroshi Tsubokawa
 See LICENSE and README
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "ast.h"
+#include "cache.h"
 #include "cgen.h"
+#include "emitter.h"
+#include "memory.h"
 #include "parser.h"
+#include "report.h"
+#include "stream.h"
 #include "symbol.h"
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-int main(int argc, const char **argv)
+struct options {
+  /* -p */
+  int print_c;
+  /* -t */
+  int print_tree;
+  /* -g: #line directives back to the .es source and cc -g */
+  int line_directives;
+  /* -k: keeps the generated C after compiling it */
+  int keep_c;
+  /* -j: files compiled at the same time */
+  int jobs;
+  /* -C: directory of the compilation cache */
+  const char *cache_dir;
+  /* --time-report[=json] */
+  enum report_format time_report;
+};
+
+#define OPTIONS_INIT {0,0,0,0,1,NULL,REPORT_NONE}
+
+/* cache size in MiB unless EC_CACHE_SIZE is set */
+#define DEFAULT_CACHE_SIZE 256
+
+/* the most arguments of a cc command for one file */
+#define MAX_CC_ARGS 16
+
+/* given to cc for every file. part of the cache key */
+static const char *const cc_flags[] = {"-Wall", "-ansi", "-O3", NULL};
+
+static int wait_child(pid_t pid)
+{
+  int status = 0;
+
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR) {
+      return 0;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* runs argv feeding input, when not NULL, to its stdin.
+   returns 1 when the command succeeds */
+static int run_command(const char *const *argv, const struct emitter *input)
+{
+  size_t written = 0;
+  int fds[2] = {-1, -1};
+  pid_t pid;
+
+  if (input != NULL && pipe(fds) == -1) {
+    perror("error: pipe");
+    return 0;
+  }
+
+  pid = fork();
+  if (pid == -1) {
+    perror("error: fork");
+    if (input != NULL) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+    return 0;
+  }
+  if (pid == 0) {
+    if (input != NULL) {
+      dup2(fds[0], STDIN_FILENO);
+      close(fds[0]);
+      close(fds[1]);
+    }
+    execvp(argv[0], (char *const *) argv);
+    perror(argv[0]);
+    _exit(127);
+  }
+
+  if (input == NULL) {
+    return wait_child(pid);
+  }
+
+  close(fds[0]);
+  /* cc may exit early on errors. write fails with EPIPE then */
+  signal(SIGPIPE, SIG_IGN);
+  while (written < input->len) {
+    const ssize_t n = write(fds[1], input->buf + written, input->len - written);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    written += n;
+  }
+  close(fds[1]);
+
+  return wait_child(pid);
+}
+
+/* compiles the code with cc through a pipe. makes the object file
+   when object is not NULL, otherwise a.out */
+static int run_cc(const struct emitter *code, const struct options *opt,
+    const char *object)
+{
+  const char *argv[MAX_CC_ARGS];
+  const char *const *flag;
+  int n = 0;
+
+  argv[n++] = "cc";
+  if (opt->line_directives) {
+    argv[n++] = "-g";
+  }
+  for (flag = cc_flags; *flag != NULL; flag++) {
+    argv[n++] = *flag;
+  }
+  if (object != NULL) {
+    argv[n++] = "-c";
+    argv[n++] = "-o";
+    argv[n++] = object;
+  }
+  argv[n++] = "-x";
+  argv[n++] = "c";
+  argv[n++] = "-";
+  argv[n++] = NULL;
+
+  return run_command(argv, code);
+}
+
+/* filename followed by suffix in a new string, or NULL */
+static char *with_suffix(const char *filename, const char *suffix)
+{
+  char *name = MEMORY_ALLOC_ARRAY(char, strlen(filename) + strlen(suffix) + 1);
+
+  if (name == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    return NULL;
+  }
+  strcpy(name, filename);
+  strcat(name, suffix);
+  return name;
+}
+
+/* saves a copy of the code at cfile */
+static int write_c_file(const struct emitter *code, const char *cfile)
+{
+  FILE *fp = fopen(cfile, "w");
+  int ok = 0;
+
+  if (fp == NULL) {
+    perror(cfile);
+    return 0;
+  }
+  ok = fwrite(code->buf, 1, code->len, fp) == code->len;
+  ok = fclose(fp) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "error: failed to write %s\n", cfile);
+  }
+  return ok;
+}
+
+static int copy_file(const char *src, const char *dst)
+{
+  char buf[64 * 1024];
+  FILE *in = fopen(src, "rb");
+  FILE *out = NULL;
+  size_t n;
+  int ok = 1;
+
+  if (in == NULL) {
+    perror(src);
+    return 0;
+  }
+  out = fopen(dst, "wb");
+  if (out == NULL) {
+    perror(dst);
+    fclose(in);
+    return 0;
+  }
+  while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    ok = fwrite(buf, 1, n, out) == n;
+  }
+  ok = !ferror(in) && ok;
+  fclose(in);
+  ok = fclose(out) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "error: failed to copy %s to %s\n", src, dst);
+  }
+  return ok;
+}
+
+/* a worker sends its report in one write to a pipe of its own, which
+   holds it whole without waiting for the parent to read */
+typedef char time_report_fits_in_pipe_write[
+    sizeof(struct time_report) <= _POSIX_PIPE_BUF ? 1 : -1];
+
+static void count_node(const struct ast_node *node, enum ast_visit_order order,
+    void *data)
+{
+  if (order == AST_VISIT_PRE) {
+    ++*(unsigned long *) data;
+  }
+}
+
+/* parses one file and prints it or compiles it, keeping a copy of the
+   C code at cfile when it is not NULL. the file is read unless its text
+   is given. the phases go to times when it is not NULL. syntax errors
+   exit. returns 0 on success, otherwise -1 */
+static int compile_file(const char *filename, const char *text, size_t text_len,
+    const struct options *opt, const char *object, const char *cfile,
+    struct time_report *times)
 {
-  const char *filename = NULL;
   struct ast_node *node = NULL;
   struct symbol_table *symtbl = NULL;
+  struct interner *names = NULL;
+  struct constant_pool *consts = NULL;
+  struct arena nodes = ARENA_INIT;
   struct parser p = PARSER_INIT;
-  int print_c = 0;
-  int print_tree = 0;
-  FILE *fp = NULL;
-  char cfile[128] = {'\0'};
-
-  if (argc == 3 && strcmp(argv[1], "-p") == 0) {
-    filename = argv[2];
-    fp = stdout;
-    print_c = 1;
-  } else if (argc == 3 && strcmp(argv[1], "-t") == 0) {
-    filename = argv[2];
-    fp = stdout;
-    print_tree = 1;
-  } else if (argc == 2) {
-    filename = argv[1];
-    sprintf(cfile, "%s.c", filename);
-    fp = fopen(cfile, "w");
-  } else {
-    return -1;
-  }
+  int status = 0;
 
   symtbl = new_symbol_table();
+  names = new_interner();
+  consts = new_constant_pool();
+  if (symtbl == NULL || names == NULL || consts == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    return -1;
+  }
   p.symtbl = symtbl;
+  p.names = names;
+  p.consts = consts;
+  p.nodes = &nodes;
+  p.times = times;
 
-  node = parse_file(&p, filename);
-  if (print_tree) {
+  if (text != NULL) {
+    node = parse_buffer(&p, filename, text, text_len);
+  } else {
+    node = parse_file(&p, filename);
+  }
+  if (times != NULL) {
+    ast_walk(node, count_node, &times->n_nodes);
+  }
+  if (opt->print_tree) {
     ast_print_tree(node);
   } else {
+    struct emitter code = EMITTER_INIT;
     struct context cxt = INIT_CONTEXT;
-    print_c_code(fp, node, &cxt);
-  }
+    cxt.consts = consts;
+    if (opt->line_directives) {
+      cxt.source_name = filename;
+    }
 
-  if (!print_c && !print_tree) {
-    char cmd[128] = {'\0'};
-    fclose(fp);
+    report_begin(times);
+    if (!emit_c_code(&code, node, &cxt)) {
+      status = -1;
+    }
+    report_end(times, PHASE_CODEGEN);
 
-    sprintf(cmd, "cc -Wall -ansi -O3 %s", cfile);
-    system(cmd);
-    sprintf(cmd, "rm -f %s", cfile);
-    system(cmd);
+    if (status != 0) {
+      fprintf(stderr, "error: out of memory\n");
+    } else if (opt->print_c) {
+      if (!emitter_flush(&code, stdout)) {
+        fprintf(stderr, "error: failed to write the generated code\n");
+        status = -1;
+      }
+    } else {
+      /* the code goes to cc through a pipe, the file is only a copy */
+      if (cfile != NULL && !write_c_file(&code, cfile)) {
+        status = -1;
+      } else {
+        /* without an object cc links as well */
+        report_begin(times);
+        if (!run_cc(&code, opt, object)) {
+          status = -1;
+        }
+        report_end(times, PHASE_CC);
+      }
+    }
+    free_emitter(&code);
   }
 
   free_symbol_table(symtbl);
+  free_interner(names);
+  free_constant_pool(consts);
 
-  ast_free_node(node);
+  arena_free(&nodes);
   parse_finish(&p);
-  return 0;
+  return status;
+}
+
+struct job {
+  const char *file;
+  /* when caching, the text the key hashes, which a miss compiles */
+  struct stream source;
+  size_t source_len;
+  /* linked into a.out */
+  char *object;
+  /* set when caching */
+  char key[CACHE_KEY_SIZE];
+  int needs_compile;
+  /* while compiling, the worker and the pipe of its report */
+  pid_t pid;
+  int report_fd;
+};
+
+/* the key of a file is this hashed with its contents */
+static unsigned long cache_key_base(const struct options *opt, const char *self)
+{
+  unsigned long key = CACHE_KEY_INIT;
+  const char *const *flag;
+
+  key = cache_hash_program(key, self);
+  key = cache_hash_program(key, "cc");
+  for (flag = cc_flags; *flag != NULL; flag++) {
+    key = cache_hash_string(key, *flag);
+  }
+  return cache_hash(key, &opt->line_directives, sizeof(opt->line_directives));
+}
+
+/* runs in a worker. cache misses are compiled under temporary names
+   and renamed into the cache when complete */
+static int run_job(const struct job *job, const struct options *opt,
+    const struct cache *cache, struct time_report *times)
+{
+  char suffix[64];
+  char *tmp_o = NULL;
+  char *tmp_c = NULL;
+  int status = -1;
+
+  if (cache->dir == NULL) {
+    char *cfile = opt->keep_c ? with_suffix(job->file, ".c") : NULL;
+    if (!opt->keep_c || cfile != NULL) {
+      status = compile_file(job->file, NULL, 0, opt, job->object, cfile, times);
+    }
+    MEMORY_FREE(cfile);
+    return status;
+  }
+
+  sprintf(suffix, ".o.%ld.tmp", (long) getpid());
+  tmp_o = cache_path(cache, job->key, suffix);
+  sprintf(suffix, ".c.%ld.tmp", (long) getpid());
+  tmp_c = cache_path(cache, job->key, suffix);
+  if (tmp_o != NULL && tmp_c != NULL) {
+    status = compile_file(job->file, stream_text(&job->source, 0), job->source_len,
+        opt, tmp_o, tmp_c, times);
+    if (status == 0 && !(cache_store(cache, job->key, ".c", tmp_c) &&
+        cache_store(cache, job->key, ".o", tmp_o))) {
+      fprintf(stderr, "error: failed to store %s in the cache\n", job->file);
+      status = -1;
+    }
+    if (status != 0) {
+      remove(tmp_o);
+      remove(tmp_c);
+    }
+  }
+  MEMORY_FREE(tmp_o);
+  MEMORY_FREE(tmp_c);
+  return status;
+}
+
+/* runs a job in a worker process and sends its report to report_fd
+   when it is not -1 */
+static int run_worker(const struct job *job, const struct options *opt,
+    const struct cache *cache, int report_fd)
+{
+  struct time_report times;
+  struct time_report *report = report_fd != -1 ? &times : NULL;
+  int status = 0;
+
+  report_init(report);
+  status = run_job(job, opt, cache, report);
+  if (report != NULL && write(report_fd, report, sizeof(*report)) != sizeof(*report)) {
+    perror("error: write");
+  }
+  return status;
+}
+
+/* adds the report of the finished worker of the job and closes its pipe */
+static void read_report(struct job *job, struct time_report *times)
+{
+  struct time_report worker;
+
+  if (read(job->report_fd, &worker, sizeof(worker)) == sizeof(worker)) {
+    report_merge(times, &worker);
+  } else {
+    fprintf(stderr, "warning: %s: time report missing from the totals\n", job->file);
+  }
+  close(job->report_fd);
+  job->report_fd = -1;
+}
+
+/* a new private directory for the objects of a build, or NULL */
+static char *make_object_dir(void)
+{
+  const char *tmp = getenv("TMPDIR");
+  char *dir = NULL;
+
+  if (tmp == NULL || tmp[0] == '\0') {
+    tmp = "/tmp";
+  }
+  dir = with_suffix(tmp, "/ec.XXXXXX");
+  if (dir != NULL && mkdtemp(dir) == NULL) {
+    perror("error: mkdtemp");
+    MEMORY_FREE(dir);
+    return NULL;
+  }
+  return dir;
+}
+
+/* <dir>/<n>.o in a new string, or NULL. numbers keep files of the same
+   name in different directories apart */
+static char *object_path(const char *dir, int n)
+{
+  char *path = MEMORY_ALLOC_ARRAY(char, strlen(dir) + 32);
+
+  if (path != NULL) {
+    sprintf(path, "%s/%d.o", dir, n);
+  }
+  return path;
+}
+
+static void close_source(struct job *job)
+{
+  const struct stream ini_stream = STREAM_INIT;
+
+  close_stream(&job->source);
+  job->source = ini_stream;
+}
+
+/* finds the cached entries and sets where every object will be. without
+   a cache the objects go to obj_dir */
+static int plan_jobs(struct job *jobs, int n_jobs, const struct options *opt,
+    const struct cache *cache, const char *obj_dir, const char *self, int *n_hits)
+{
+  const unsigned long base = cache->dir != NULL ? cache_key_base(opt, self) : 0;
+  int i;
+
+  for (i = 0; i < n_jobs; i++) {
+    struct job *job = &jobs[i];
+    unsigned long key = base;
+
+    if (cache->dir == NULL) {
+      job->object = object_path(obj_dir, i);
+      job->needs_compile = 1;
+    } else if (open_file_stream(&job->source, job->file) != 0) {
+      perror(job->file);
+      return 0;
+    } else {
+      /* the worker compiles this very text, so a file edited during the
+         build is never stored under the key of another text */
+      job->source_len = stream_read_all(&job->source);
+      key = cache_hash(key, stream_text(&job->source, 0), job->source_len);
+      /* #line directives name the file, so the object depends on it */
+      if (opt->line_directives) {
+        key = cache_hash_string(key, job->file);
+      }
+      cache_key_string(key, job->key);
+      job->object = cache_path(cache, job->key, ".o");
+      job->needs_compile = !cache_lookup(cache, job->key);
+      *n_hits += !job->needs_compile;
+      if (!job->needs_compile) {
+        close_source(job);
+      }
+    }
+    if (job->object == NULL) {
+      fprintf(stderr, "error: out of memory\n");
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Compiles every file to an object in a worker process of its own, at
+  most opt->jobs at a time, then links the objects into a.out. Processes
+  keep the compilations apart and a syntax error only ends its own worker.
+  With a cache the objects are cache entries and hits are not compiled,
+  otherwise they go to a private temporary directory removed at the end.
+*/
+static int build_files(const char **files, int n_files, const struct options *opt,
+    const char *self, struct time_report *times)
+{
+  const struct stream ini_stream = STREAM_INIT;
+  struct cache cache = CACHE_INIT;
+  char *obj_dir = NULL;
+  struct job *jobs = MEMORY_ALLOC_ARRAY(struct job, n_files);
+  const char **link_argv = MEMORY_ALLOC_ARRAY(const char *, n_files + 2);
+  int n_running = 0;
+  int n_hits = 0;
+  int next = 0;
+  int failed = 0;
+  int i;
+
+  if (jobs == NULL || link_argv == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    MEMORY_FREE(jobs);
+    MEMORY_FREE(link_argv);
+    return -1;
+  }
+  for (i = 0; i < n_files; i++) {
+    jobs[i].file = files[i];
+    jobs[i].source = ini_stream;
+    jobs[i].source_len = 0;
+    jobs[i].object = NULL;
+    jobs[i].key[0] = '\0';
+    jobs[i].needs_compile = 0;
+    jobs[i].pid = -1;
+    jobs[i].report_fd = -1;
+  }
+
+  if (opt->cache_dir != NULL) {
+    const char *size = getenv("EC_CACHE_SIZE");
+    const unsigned long mib = size != NULL ? strtoul(size, NULL, 10) : DEFAULT_CACHE_SIZE;
+
+    if (!open_cache(&cache, opt->cache_dir, mib * 1024 * 1024)) {
+      failed = 1;
+    }
+  } else {
+    /* objects never land next to the sources, which may be read-only
+       or shared with another build */
+    obj_dir = make_object_dir();
+    failed = obj_dir == NULL;
+  }
+  if (!failed && !plan_jobs(jobs, n_files, opt, &cache, obj_dir, self, &n_hits)) {
+    failed = 1;
+  }
+
+  while (next < n_files || n_running > 0) {
+    int status = 0;
+    pid_t pid;
+
+    while (!failed && n_running < opt->jobs && next < n_files) {
+      int report_fds[2] = {-1, -1};
+
+      if (!jobs[next].needs_compile) {
+        next++;
+        continue;
+      }
+      if (times != NULL && pipe(report_fds) == -1) {
+        perror("error: pipe");
+        failed = 1;
+        break;
+      }
+      pid = fork();
+      if (pid == 0) {
+        _exit(run_worker(&jobs[next], opt, &cache, report_fds[1]) == 0 ? 0 : 1);
+      }
+      if (report_fds[1] != -1) {
+        close(report_fds[1]);
+      }
+      if (pid == -1) {
+        perror("error: fork");
+        if (report_fds[0] != -1) {
+          close(report_fds[0]);
+        }
+        failed = 1;
+        break;
+      }
+      jobs[next].pid = pid;
+      jobs[next].report_fd = report_fds[0];
+      next++;
+      n_running++;
+    }
+    if (n_running == 0) {
+      break;
+    }
+
+    pid = wait(&status);
+    if (pid == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("error: wait");
+      failed = 1;
+      break;
+    }
+    n_running--;
+    for (i = 0; i < n_files; i++) {
+      if (jobs[i].pid == pid && jobs[i].report_fd != -1) {
+        read_report(&jobs[i], times);
+      }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      /* lets the running workers finish but starts no more */
+      failed = 1;
+    }
+  }
+
+  if (!failed) {
+    link_argv[0] = "cc";
+    for (i = 0; i < n_files; i++) {
+      link_argv[i + 1] = jobs[i].object;
+    }
+    link_argv[n_files + 1] = NULL;
+    report_begin(times);
+    failed = !run_command(link_argv, NULL);
+    report_end(times, PHASE_LINK);
+  }
+
+  if (cache.dir != NULL) {
+    /* the C code of hits and misses alike comes from the cache */
+    for (i = 0; !failed && opt->keep_c && i < n_files; i++) {
+      char *src = cache_path(&cache, jobs[i].key, ".c");
+      char *dst = with_suffix(jobs[i].file, ".c");
+      failed = src == NULL || dst == NULL || !copy_file(src, dst);
+      MEMORY_FREE(src);
+      MEMORY_FREE(dst);
+    }
+    fprintf(stderr, "cache: %d hits, %d misses\n", n_hits, n_files - n_hits);
+    cache_evict(&cache);
+  }
+
+  for (i = 0; i < n_files; i++) {
+    if (obj_dir != NULL && jobs[i].object != NULL) {
+      remove(jobs[i].object);
+    }
+    MEMORY_FREE(jobs[i].object);
+    close_source(&jobs[i]);
+  }
+  if (obj_dir != NULL) {
+    rmdir(obj_dir);
+    MEMORY_FREE(obj_dir);
+  }
+  for (i = 0; i < n_files; i++) {
+    if (jobs[i].report_fd != -1) {
+      close(jobs[i].report_fd);
+    }
+  }
+  close_cache(&cache);
+  MEMORY_FREE(jobs);
+  MEMORY_FREE(link_argv);
+  return failed ? -1 : 0;
+}
+
+int main(int argc, const char **argv)
+{
+  struct options opt = OPTIONS_INIT;
+  struct time_report report;
+  struct time_report *times = NULL;
+  const char **files = NULL;
+  int n_files = 0;
+  int status = 0;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+    if (strcmp(argv[i], "-p") == 0) {
+      opt.print_c = 1;
+    } else if (strcmp(argv[i], "-t") == 0) {
+      opt.print_tree = 1;
+    } else if (strcmp(argv[i], "-g") == 0) {
+      opt.line_directives = 1;
+    } else if (strcmp(argv[i], "-k") == 0) {
+      opt.keep_c = 1;
+    } else if (strncmp(argv[i], "-j", 2) == 0) {
+      /* -j N or -jN */
+      const char *n = argv[i][2] != '\0' ? argv[i] + 2 : argv[++i];
+      if (n == NULL || (opt.jobs = atoi(n)) < 1) {
+        fprintf(stderr, "error: -j needs a positive number\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--time-report") == 0 ||
+        strcmp(argv[i], "--time-report=text") == 0) {
+      opt.time_report = REPORT_TEXT;
+    } else if (strcmp(argv[i], "--time-report=json") == 0) {
+      opt.time_report = REPORT_JSON;
+    } else if (strncmp(argv[i], "-C", 2) == 0) {
+      /* -C DIR or -CDIR */
+      opt.cache_dir = argv[i][2] != '\0' ? argv[i] + 2 : argv[++i];
+      if (opt.cache_dir == NULL) {
+        fprintf(stderr, "error: -C needs a directory\n");
+        return -1;
+      }
+    } else {
+      return -1;
+    }
+  }
+  files = argv + i;
+  n_files = argc - i;
+  if (n_files < 1) {
+    return -1;
+  }
+
+  times = opt.time_report != REPORT_NONE ? &report : NULL;
+  report_init(times);
+
+  if (opt.print_c || opt.print_tree) {
+    /* printing keeps the files in order, one after another */
+    for (i = 0; i < n_files && status == 0; i++) {
+      status = compile_file(files[i], NULL, 0, &opt, NULL, NULL, times);
+    }
+  } else if (n_files == 1 && opt.cache_dir == NULL) {
+    char *cfile = opt.keep_c ? with_suffix(files[0], ".c") : NULL;
+    if (opt.keep_c && cfile == NULL) {
+      return -1;
+    }
+    status = compile_file(files[0], NULL, 0, &opt, NULL, cfile, times);
+    MEMORY_FREE(cfile);
+  } else {
+    status = build_files(files, n_files, &opt, argv[0], times);
+  }
+
+  report_finish(times);
+  report_print(times, opt.time_report, stderr);
+  return status;
 }
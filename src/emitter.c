@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#include "emitter.h"
+#include "memory.h"
+#include <string.h>
+
+#define INITIAL_CAPACITY (64 * 1024)
+
+/* indentation of up to 32 levels is a single copy */
+static const char spaces[] =
+    "                                "
+    "                                ";
+#define N_SPACES (sizeof(spaces) - 1)
+
+/* with no room left every later append goes to reserve, which refuses it */
+static int fail(struct emitter *e)
+{
+  e->cap = e->len;
+  e->failed = 1;
+  return 0;
+}
+
+static int reserve(struct emitter *e, size_t n)
+{
+  size_t new_cap = e->cap == 0 ? INITIAL_CAPACITY : e->cap;
+  char *new_buf = NULL;
+
+  if (e->failed) {
+    return 0;
+  }
+  while (new_cap - e->len < n) {
+    /* fails before doubling wraps around */
+    if (new_cap > (size_t) -1 / 2) {
+      return fail(e);
+    }
+    new_cap *= 2;
+  }
+  new_buf = MEMORY_REALLOC_ARRAY(e->buf, char, new_cap);
+  if (new_buf == NULL) {
+    return fail(e);
+  }
+  e->buf = new_buf;
+  e->cap = new_cap;
+  return 1;
+}
+
+void emit_chars(struct emitter *e, const char *s, size_t n)
+{
+  if (e->cap - e->len < n && !reserve(e, n)) {
+    return;
+  }
+  memcpy(e->buf + e->len, s, n);
+  e->len += n;
+}
+
+void emit_str(struct emitter *e, const char *s)
+{
+  emit_chars(e, s, strlen(s));
+}
+
+void emit_char(struct emitter *e, char c)
+{
+  if (e->len == e->cap && !reserve(e, 1)) {
+    return;
+  }
+  e->buf[e->len++] = c;
+}
+
+void emit_ulong(struct emitter *e, unsigned long n)
+{
+  char digits[32];
+  int i = sizeof(digits);
+
+  do {
+    digits[--i] = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+
+  emit_chars(e, digits + i, sizeof(digits) - i);
+}
+
+void emit_long(struct emitter *e, long n)
+{
+  if (n < 0) {
+    emit_char(e, '-');
+    /* negates in unsigned so LONG_MIN does not overflow */
+    emit_ulong(e, 0UL - (unsigned long) n);
+  } else {
+    emit_ulong(e, n);
+  }
+}
+
+void emit_indent(struct emitter *e, int depth)
+{
+  size_t n = depth > 0 ? 2 * (size_t) depth : 0;
+
+  while (n > N_SPACES) {
+    emit_chars(e, spaces, N_SPACES);
+    n -= N_SPACES;
+  }
+  emit_chars(e, spaces, n);
+}
+
+int emitter_flush(struct emitter *e, FILE *fp)
+{
+  const int ok = !e->failed &&
+      (e->len == 0 || fwrite(e->buf, 1, e->len, fp) == e->len);
+
+  e->len = 0;
+  if (e->failed) {
+    e->cap = 0;
+  }
+  return ok;
+}
+
+void free_emitter(struct emitter *e)
+{
+  const struct emitter ini_emitter = EMITTER_INIT;
+
+  MEMORY_FREE(e->buf);
+  *e = ini_emitter;
+}
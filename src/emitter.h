@@ -0,0 +1,42 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+  Growable output buffer for generated code. Text is appended in memory
+  and written out at once by emitter_flush. When memory runs out the
+  emitter stops appending and remembers the failure, so callers check
+  once at the end instead of after every append.
+*/
+struct emitter {
+  char *buf;
+  size_t len;
+  size_t cap;
+  int failed;
+};
+
+#define EMITTER_INIT {NULL,0,0,0}
+
+extern void emit_chars(struct emitter *e, const char *s, size_t n);
+extern void emit_str(struct emitter *e, const char *s);
+extern void emit_char(struct emitter *e, char c);
+extern void emit_long(struct emitter *e, long n);
+extern void emit_ulong(struct emitter *e, unsigned long n);
+/* two spaces per depth */
+extern void emit_indent(struct emitter *e, int depth);
+
+/* s must be a string literal, whose length is known at compile time */
+#define EMIT_LITERAL(e,s) (emit_chars((e), "" s, sizeof(s) - 1))
+
+/* writes and empties the buffer. returns 0 on failure, otherwise 1 */
+extern int emitter_flush(struct emitter *e, FILE *fp);
+extern void free_emitter(struct emitter *e);
+
+#endif /* XXX_H */
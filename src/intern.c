@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#include "intern.h"
+#include "arena.h"
+#include "memory.h"
+#include <string.h>
+
+/* a power of two */
+#define INITIAL_CAPACITY 4096
+
+/* stored right before the characters of each name */
+struct header {
+  unsigned long hash;
+  int len;
+  int id;
+};
+
+#define HEADER_OF(name) ((const struct header *) (name) - 1)
+
+static unsigned long hash_string(const char *key, int len);
+
+struct interner {
+  /* names by hash. a slot is empty when NULL */
+  const char **slots;
+  unsigned long capacity;
+  int count;
+  struct arena arena;
+};
+
+static const char **find_slot(const struct interner *in,
+    const char *key, int len, unsigned long h)
+{
+  const unsigned long mask = in->capacity - 1;
+  unsigned long i = h & mask;
+
+  for (;;) {
+    const char **slot = &in->slots[i];
+
+    if (*slot == NULL) {
+      return slot;
+    }
+    if (HEADER_OF(*slot)->hash == h && HEADER_OF(*slot)->len == len &&
+        memcmp(*slot, key, len) == 0) {
+      return slot;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+static int grow_table(struct interner *in)
+{
+  const unsigned long new_capacity = in->capacity * 2;
+  const unsigned long mask = new_capacity - 1;
+  const char **new_slots = MEMORY_ALLOC_ARRAY(const char *, new_capacity);
+  unsigned long i;
+
+  if (new_slots == NULL) {
+    return 0;
+  }
+  for (i = 0; i < new_capacity; i++) {
+    new_slots[i] = NULL;
+  }
+
+  for (i = 0; i < in->capacity; i++) {
+    const char *name = in->slots[i];
+    unsigned long j;
+
+    if (name == NULL) {
+      continue;
+    }
+    for (j = HEADER_OF(name)->hash & mask; new_slots[j] != NULL; j = (j + 1) & mask) {
+    }
+    new_slots[j] = name;
+  }
+
+  MEMORY_FREE(in->slots);
+  in->slots = new_slots;
+  in->capacity = new_capacity;
+  return 1;
+}
+
+struct interner *new_interner(void)
+{
+  struct interner *in = MEMORY_ALLOC(struct interner);
+  const struct arena ini_arena = ARENA_INIT;
+  unsigned long i;
+
+  if (in == NULL) {
+    return NULL;
+  }
+  in->slots = MEMORY_ALLOC_ARRAY(const char *, INITIAL_CAPACITY);
+  if (in->slots == NULL) {
+    MEMORY_FREE(in);
+    return NULL;
+  }
+  for (i = 0; i < INITIAL_CAPACITY; i++) {
+    in->slots[i] = NULL;
+  }
+  in->capacity = INITIAL_CAPACITY;
+  in->count = 0;
+  in->arena = ini_arena;
+  return in;
+}
+
+void free_interner(struct interner *in)
+{
+  if (in == NULL) {
+    return;
+  }
+  arena_free(&in->arena);
+  MEMORY_FREE(in->slots);
+  MEMORY_FREE(in);
+}
+
+const char *intern(struct interner *in, const char *str, int len)
+{
+  const unsigned long h = hash_string(str, len);
+  const char **slot = find_slot(in, str, len, h);
+  struct header *head = NULL;
+  char *name = NULL;
+
+  if (*slot != NULL) {
+    return *slot;
+  }
+
+  /* keeps the table at most half full */
+  if ((unsigned long) (in->count + 1) * 2 > in->capacity) {
+    if (!grow_table(in)) {
+      return NULL;
+    }
+    slot = find_slot(in, str, len, h);
+  }
+
+  head = (struct header *) arena_alloc(&in->arena,
+      sizeof(struct header) + len + 1);
+  if (head == NULL) {
+    return NULL;
+  }
+  head->hash = h;
+  head->len = len;
+  head->id = in->count++;
+
+  name = (char *) (head + 1);
+  memcpy(name, str, len);
+  name[len] = '\0';
+
+  *slot = name;
+  return name;
+}
+
+int intern_count(const struct interner *in)
+{
+  return in->count;
+}
+
+unsigned long intern_hash(const char *name)
+{
+  return HEADER_OF(name)->hash;
+}
+
+int intern_length(const char *name)
+{
+  return HEADER_OF(name)->len;
+}
+
+int intern_id(const char *name)
+{
+  return HEADER_OF(name)->id;
+}
+
+/* FxHash style: rotate, xor in a byte and multiply by the golden ratio.
+   the final shift folds the well mixed high bits into the low ones */
+static unsigned long hash_string(const char *key, int len)
+{
+  unsigned long h = 0;
+  const unsigned char *p = (const unsigned char *) key;
+  const unsigned char *end = p + len;
+
+  for (; p != end; p++) {
+    h = ((h << 5 | h >> 27) ^ *p) * 0x9E3779B9UL & 0xFFFFFFFFUL;
+  }
+
+  return h ^ h >> 16;
+}
@@ -0,0 +1,30 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef INTERN_H
+#define INTERN_H
+
+/*
+  Maps each distinct spelling to one canonical null terminated copy, so
+  interned names compare equal exactly when their pointers do. The hash,
+  length and id of an interned name are stored with it and read back
+  without touching the characters. Names live until free_interner.
+*/
+struct interner;
+
+extern struct interner *new_interner(void);
+extern void free_interner(struct interner *in);
+
+/* returns the canonical copy of len characters of str, or NULL */
+extern const char *intern(struct interner *in, const char *str, int len);
+/* number of distinct names. ids are 0 to this minus one */
+extern int intern_count(const struct interner *in);
+
+/* name must have been returned by intern */
+extern unsigned long intern_hash(const char *name);
+extern int intern_length(const char *name);
+extern int intern_id(const char *name);
+
+#endif /* XXX_H */
@@ -3,11 +3,23 @@ Copyright (c) 2012-2015 Hiroshi Tsubokawa
 See LICENSE and README
 */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "lexer.h"
 #include "memory.h"
 #include "token.h"
+#include "type.h"
+#include "scan.h"
+#include "intern.h"
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* inputs are split into chunks of about this size to lex in parallel */
+#define PARALLEL_CHUNK_SIZE (256 * 1024)
+#define MAX_CHUNKS 256
 
 static void fwd_tokbuf(struct lexer *l)
 {
@@ -49,29 +61,146 @@ static void detect_newline(struct lexer *l)
   l->column = 0;
 }
 
-static const struct keyword {
-  int id;
-  const char *word;
-} keywords[] = {
-#define T(id,str) {id, str},
-  KEYWORD_LIST(T)
-#undef T
-  {0, ""}
-};
+/* consumes the window up to p, which was found by one of the scanners */
+static void skip_to(struct lexer *l, const char *p)
+{
+  const char *end = NULL;
+  const size_t n = p - stream_window(&l->strm, &end);
+
+  stream_skip(&l->strm, n);
+  l->column += n;
+}
+
+/* keyword_table and KEYWORD_HASH are generated by mkkeywords */
+#include "keywords.h"
 
-static const size_t N_KEYWORDS = sizeof(keywords)/sizeof(keywords[0]);
 static void keyword_or_identifier(struct token *tok)
 {
+  const struct keyword *key = NULL;
+
+  tok->kind = TK_IDENTIFIER;
+  if (tok->len > KEYWORD_MAX_LEN) {
+    return;
+  }
+
+  key = &keyword_table[KEYWORD_HASH(tok->word, tok->len)];
+  if (key->len == tok->len && memcmp(key->word, tok->word, tok->len) == 0) {
+    tok->kind = key->id;
+  }
+}
+
+/* points the token at the source text read since pos */
+static void set_span(struct lexer *l, struct token *tok, size_t pos)
+{
+  tok->word = stream_text(&l->strm, pos);
+  tok->len = stream_position(&l->strm) - pos;
+}
+
+static int hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/* decodes the escape sequence after a backslash at src, storing the
+   character in c. returns where the sequence ends */
+static const char *escape_char(const char *src, const char *end, char *c)
+{
+  int n = 0;
   int i;
 
-  for (i = 0; i < N_KEYWORDS; i++) {
-    const struct keyword *key = &keywords[i];
-    if (strcmp(tok->value.word, key->word) == 0) {
-      tok->kind = key->id;
-      return;
+  switch (*src) {
+  case 'n': *c = '\n'; return src + 1;
+  case 't': *c = '\t'; return src + 1;
+  case 'r': *c = '\r'; return src + 1;
+  case 'v': *c = '\v'; return src + 1;
+  case 'f': *c = '\f'; return src + 1;
+  case 'b': *c = '\b'; return src + 1;
+  case 'a': *c = '\a'; return src + 1;
+  case 'x':
+    /* \xhh. without digits it stays an x */
+    for (i = 1; i <= 2 && src + i < end && hex_digit(src[i]) >= 0; i++) {
+      n = n * 16 + hex_digit(src[i]);
     }
+    *c = i > 1 ? (char) n : 'x';
+    return src + i;
+  default:
+    break;
   }
-  tok->kind = TK_IDENTIFIER;
+
+  /* \ooo with one to three digits */
+  if (*src >= '0' && *src <= '7') {
+    for (i = 0; i < 3 && src + i < end && src[i] >= '0' && src[i] <= '7'; i++) {
+      n = n * 8 + (src[i] - '0');
+    }
+    *c = (char) n;
+    return src + i;
+  }
+
+  *c = *src;
+  return src + 1;
+}
+
+/* copies the string literal span of the token into the string arena
+   decoding escape sequences. returns 0 on memory allocation failure */
+static int decode_string(struct lexer *l, struct token *tok)
+{
+  const char *src = tok->word;
+  const char *end = src + tok->len;
+  char *dst = (char *) arena_alloc(&l->strings, tok->len + 1);
+  int len = 0;
+
+  if (dst == NULL) {
+    return 0;
+  }
+
+  while (src < end) {
+    if (*src == '\\' && src + 1 < end) {
+      src = escape_char(src + 1, end, &dst[len++]);
+    } else {
+      dst[len++] = *src++;
+    }
+  }
+  dst[len] = '\0';
+
+  tok->value.String = dst;
+  tok->word = dst;
+  tok->len = len;
+  return 1;
+}
+
+/* points the token at the canonical copy of its spelling.
+   returns 0 on memory allocation failure */
+static int intern_token(struct interner *names, struct token *tok)
+{
+  const char *name = NULL;
+
+  switch (tok->kind) {
+  case TK_IDENTIFIER:
+  case TK_NUMBER:
+  case TK_STRING_LITERAL:
+    break;
+  default:
+    return 1;
+  }
+
+  name = intern(names, tok->word, tok->len);
+  if (name == NULL) {
+    return 0;
+  }
+  tok->word = name;
+  if (tok->kind == TK_STRING_LITERAL) {
+    tok->value.String = name;
+  }
+  return 1;
 }
 
 static int isidentifier(char c)
@@ -81,34 +210,57 @@ static int isidentifier(char c)
 
 static char scan_word(struct lexer *l, struct token *tok)
 {
-  char *dst = tok->value.word;
+  const size_t pos = stream_position(&l->strm);
+  const char *end = NULL;
+  const char *p = stream_window(&l->strm, &end);
   char c = '\0';
 
+  /* the scalar loop finishes words crossing the end of the window */
+  skip_to(l, scan_identifier(p, end));
   while ((c = get_ch(l)) != '\0') {
-    if (isidentifier(c)) {
-      *dst++ = c;
-    } else {
+    if (!isidentifier(c)) {
       c = unget_ch(l);
       break;
     }
   }
-  *dst = '\0';
+  set_span(l, tok, pos);
 
   keyword_or_identifier(tok);
   return c;
 }
 
-enum number_type {
-  NUM_INT,
-  NUM_DOUBLE,
-  NUM_FLOAT
-};
+/* the longest number spelling converted. longer ones are bad anyway */
+#define MAX_NUMBER_LEN 63
+
+/* converts the spelling of the token to its binary value and type */
+static void number_value(struct token *tok, int is_float, char suffix)
+{
+  char buf[MAX_NUMBER_LEN + 1] = {'\0'};
+  const int len = tok->len < MAX_NUMBER_LEN ? tok->len : MAX_NUMBER_LEN;
+
+  /* the span is not null terminated and may end the mapped input */
+  memcpy(buf, tok->word, len);
+
+  if (is_float) {
+    tok->value.Float = strtod(buf, NULL);
+    tok->type = toupper(suffix) == 'F' ? TYPE_FLOAT : TYPE_DOUBLE;
+  } else {
+    tok->value.Integer = strtol(buf, NULL, 0);
+    if (toupper(suffix) == 'L' ||
+        tok->value.Integer > INT_MAX || tok->value.Integer < INT_MIN) {
+      tok->type = TYPE_LONG;
+    } else {
+      tok->type = TYPE_INT;
+    }
+  }
+}
 
 static char scan_number(struct lexer *l, struct token *tok)
 {
-  char *dst = tok->value.word;
+  const size_t pos = stream_position(&l->strm);
   char c = '\0';
   char prev = c;
+  char suffix = c;
   int has_e = 0;
   int has_x = 0;
   int has_pm = 0;
@@ -119,124 +271,74 @@ static char scan_number(struct lexer *l, struct token *tok)
   if (c != '.' && isdigit(c) != 0) {
     /* TODO assert */
   }
-  *dst++ = prev = c;
+  prev = c;
 
   for (;;) {
     c = get_ch(l);
 
     if (isdigit(c)) {
-      *dst++ = prev = c;
+      prev = c;
+    }
+    else if (has_x && isxdigit(c)) {
+      prev = c;
     }
     else if (toupper(c)=='X' && prev=='0' && has_x==0) {
-      *dst++ = prev = c;
+      prev = c;
       has_x = 1;
     }
     else if (toupper(c)=='E' && prev!='.' && has_e==0) {
-      *dst++ = prev = c;
+      prev = c;
       has_e = 1;
     }
     else if ((c=='+' || c=='-') && toupper(prev)=='E' && has_pm==0) {
-      *dst++ = prev = c;
+      prev = c;
       has_pm = 1;
     }
     else if (c=='.' && has_dot==0) {
-      *dst++ = prev = c;
+      prev = c;
       has_dot = 1;
     }
     else if (toupper(c)=='F') {
-      *dst++ = prev = c;
+      prev = c;
+      suffix = c;
       break;
     }
     else if (toupper(c)=='X' || toupper(c)=='U' || toupper(c)=='L') {
-      *dst++ = prev = c;
+      prev = c;
+      suffix = c;
       break;
     }
     else {
-      unget_ch(l);
+      /* nothing to push back at the end of input */
+      if (c != '\0') {
+        unget_ch(l);
+      }
       break;
     }
   }
 
-  *dst = '\0';
+  set_span(l, tok, pos);
   tok->kind = TK_NUMBER;
+  number_value(tok, has_dot || has_e || toupper(suffix) == 'F', suffix);
 
   return prev;
 }
 
-#if 0
-static char scan_number(struct lexer *l, struct token *tok)
-{
-  char buf[265] = {'\0'};
-  char ch = '\0';
-  char *end = NULL;
-  int i = 0;
-  int num_type = NUM_INT;
-
-state_initial:
-  ch = get_ch(l);
-
-  switch (ch) {
-  case '+': case '-':
-    if (i > 0) {
-      num_type = NUM_DOUBLE;
-    }
-    buf[i++] = ch;
-    goto state_initial;
-
-  case '.': case 'e': case 'E':
-    num_type = NUM_DOUBLE;
-    buf[i++] = ch;
-    goto state_initial;
-
-  case 'f': case 'F':
-    num_type = NUM_FLOAT;
-    buf[i++] = ch;
-    buf[i] = '\0';
-    break;
-
-  case 'x': case 'X':
-  case 'u': case 'U':
-  case 'l': case 'L':
-  case '0': case '1': case '2': case '3': case '4':
-  case '5': case '6': case '7': case '8': case '9':
-    buf[i++] = ch;
-    goto state_initial;
-
-  default:
-    buf[i] = '\0';
-    ch = unget_ch(l);
-    break;
-  }
-
-  switch (num_type) {
-  case NUM_FLOAT:
-  case NUM_DOUBLE:
-    tok->value.Float = strtod(buf, &end);
-    tok->kind = TK_NUMBER;
-    break;
-
-  default:
-    tok->value.Integer = strtol(buf, &end, 0);
-    tok->kind = TK_NUMBER;
-    break;
-  }
-
-  if (*end != '\0') {
-    /* TODO BAD FORMAT */
-  }
-
-  return ch;
-}
-#endif
-
-static char strbuf[1024] = {'\0'};
-static int ci = 0;
-
+/* reads the next token into tok. returns its kind, or -1 on memory
+   allocation failure */
 static int read_token(struct lexer *l, struct token *tok)
 {
   char ch = '\0';
+  size_t pos = 0;
+  const char *p = NULL;
+  const char *end = NULL;
 
 state_initial:
+  p = stream_window(&l->strm, &end);
+  skip_to(l, scan_blanks(p, end));
+  tok->loc.offset = l->base + stream_position(&l->strm);
+  tok->loc.line = l->line;
+  tok->loc.column = l->column + 1;
   ch = get_ch(l);
 
   switch (ch) {
@@ -254,20 +356,25 @@ state_initial:
     goto state_final;
 
   case '\'':
+    pos = stream_position(&l->strm);
     ch = get_ch(l);
     if (get_ch(l) == '\'') {
       tok->kind = TK_NUMBER;
-      tok->value.word[0] = ch;
-      tok->value.word[1] = '\0';
+      tok->word = stream_text(&l->strm, pos);
+      tok->len = 1;
+      tok->value.Integer = (unsigned char) ch;
+      tok->type = TYPE_CHAR;
       goto state_final;
     } else {
-      ch = unget_ch(l);
-      tok->kind = ch;
+      /* a stray quote is a token of its own */
+      unget_ch(l);
+      unget_ch(l);
+      tok->kind = '\'';
       goto state_final;
     }
 
   case '"':
-    ci = 0;
+    pos = stream_position(&l->strm);
     goto state_string_literal;
 
   case '+':
@@ -437,15 +544,53 @@ state_string_literal:
   switch (ch) {
   case '"':
     tok->kind = TK_STRING_LITERAL;
-    strbuf[ci] = '\0';
-    tok->value.String = strbuf;
+    set_span(l, tok, pos);
+    tok->len--;
+    if (!decode_string(l, tok)) {
+      tok->kind = '\0';
+      return -1;
+    }
     goto state_final;
+  case '\\':
+    /* the escaped character never ends the literal */
+    ch = get_ch(l);
+    if (ch == '\0') {
+      /* unterminated, as for the case below */
+      tok->kind = ch;
+      goto state_final;
+    }
+    if (ch == '\n') {
+      detect_newline(l);
+    }
+    goto state_string_literal;
+  case '\0':
+    /* unterminated. the '\0' token is a syntax error to the parser */
+    tok->kind = ch;
+    goto state_final;
+  case '\n':
+    detect_newline(l);
+    goto state_string_literal;
   default:
-    strbuf[ci++] = ch;
     goto state_string_literal;
   }
 
 state_block_comment:
+  {
+    const char *last_line = NULL;
+    int closed = 0;
+    int n_lines = 0;
+
+    p = stream_window(&l->strm, &end);
+    p = scan_block_comment(p, end, &closed, &n_lines, &last_line);
+    skip_to(l, p);
+    if (n_lines > 0) {
+      l->line += n_lines;
+      l->column = p - (last_line + 1);
+    }
+    if (closed) {
+      goto state_initial;
+    }
+  }
   ch = get_ch(l);
   switch (ch) {
   case '*':
@@ -453,7 +598,13 @@ state_block_comment:
     switch (ch) {
     case '/':
       goto state_initial;
+    case '\0':
+      /* unterminated. the '\0' token is a syntax error to the parser */
+      tok->kind = ch;
+      goto state_final;
     default:
+      /* may be another '*' or a newline */
+      unget_ch(l);
       goto state_block_comment;
     }
   case '\0':
@@ -468,16 +619,25 @@ state_block_comment:
   }
 
 state_line_comment:
+  p = stream_window(&l->strm, &end);
+  skip_to(l, scan_line_comment(p, end));
   ch = get_ch(l);
   switch (ch) {
   case '\n':
     detect_newline(l);
     goto state_initial;
+  case '\0':
+    tok->kind = TK_EOS;
+    goto state_final;
   default:
     goto state_line_comment;
   }
 
 state_final:
+  if (l->names != NULL && !intern_token(l->names, tok)) {
+    tok->kind = '\0';
+    return -1;
+  }
   return tok->kind;
 }
 
@@ -501,7 +661,13 @@ int lex_input_file(struct lexer *l, const char *filename)
   struct lexer ll = LEXER_INIT;
 
   *l = ll;
-  err = open_file_stream(&l->strm, filename);
+  if (strcmp(filename, "-") == 0) {
+    err = open_fd_stream(&l->strm, 0);
+  } else {
+    err = open_mmap_stream(&l->strm, filename);
+    if (err)
+      err = open_file_stream(&l->strm, filename);
+  }
 
   if (err)
     return -1;
@@ -509,13 +675,327 @@ int lex_input_file(struct lexer *l, const char *filename)
     return 0;
 }
 
+int lex_input_buffer(struct lexer *l, const char *text, size_t len)
+{
+  struct lexer ll = LEXER_INIT;
+
+  *l = ll;
+  return open_buffer_stream(&l->strm, text, len);
+}
+
 void lex_finish(struct lexer *l)
 {
   close_stream(&l->strm);
+  arena_free(&l->strings);
+
+  if (l->tokens != NULL) {
+    MEMORY_FREE(l->tokens);
+    l->tokens = NULL;
+  }
+}
+
+static int push_token(struct lexer *l, const struct token *tok)
+{
+  if (l->n_tokens == l->max_tokens) {
+    const int new_max = l->max_tokens == 0 ? 1024 : l->max_tokens * 2;
+    struct token *new_tokens = MEMORY_REALLOC_ARRAY(l->tokens, struct token, new_max);
+
+    if (new_tokens == NULL) {
+      return -1;
+    }
+    l->tokens = new_tokens;
+    l->max_tokens = new_max;
+  }
+
+  l->tokens[l->n_tokens++] = *tok;
+  return 0;
+}
+
+static int tokenize_serial(struct lexer *l)
+{
+  struct token tok = TOKEN_INIT;
+
+  do {
+    if (read_token(l, &tok) == -1 || push_token(l, &tok)) {
+      return -1;
+    }
+  } while (tok.kind != TK_EOS);
+
+  l->tokcurr = -1;
+  return l->n_tokens;
+}
+
+struct chunk {
+  const char *begin;
+  const char *end;
+  int line;
+  int column;
+  unsigned int offset;
+  struct lexer lex;
+  int n_tokens;
+};
+
+struct chunk_queue {
+  struct chunk *chunks;
+  int n_chunks;
+  int next;
+  pthread_mutex_t mutex;
+};
+
+/*
+  Splits the text into at most max_chunks chunks. Chunks end at newlines
+  outside comments and string literals so that no token spans two chunks.
+  This scan follows read_token's rules for comments and literals, and it
+  counts newlines the same way so each chunk knows its first line.
+*/
+static int split_chunks(const char *begin, const char *end, int first_line,
+    struct chunk *chunks, int max_chunks)
+{
+  const size_t chunk_size = (end - begin) / max_chunks + 1;
+  const char *chunk_begin = begin;
+  const char *p = begin;
+  int chunk_line = first_line;
+  int line = first_line;
+  int n = 0;
+
+  while (p < end) {
+    switch (*p) {
+    case '\n':
+      line++;
+      p++;
+      if (p - chunk_begin >= chunk_size && n < max_chunks - 1) {
+        chunks[n].begin = chunk_begin;
+        chunks[n].end = p;
+        chunks[n].line = chunk_line;
+        n++;
+        chunk_begin = p;
+        chunk_line = line;
+      }
+      break;
+
+    case '/':
+      if (p + 1 < end && p[1] == '/') {
+        /* leaves the newline to the case above */
+        p = memchr(p, '\n', end - p);
+        if (p == NULL) {
+          p = end;
+        }
+      } else if (p + 1 < end && p[1] == '*') {
+        for (p += 2; p < end; p++) {
+          if (*p == '*' && p + 1 < end && p[1] == '/') {
+            p++;
+            break;
+          }
+          if (*p == '\n') {
+            line++;
+          }
+        }
+        p++;
+      } else {
+        p++;
+      }
+      break;
+
+    case '"':
+      for (p++; p < end && *p != '"'; p++) {
+        if (*p == '\\' && p + 1 < end) {
+          p++;
+        }
+        if (*p == '\n') {
+          line++;
+        }
+      }
+      p++;
+      break;
+
+    case '\'':
+      /* like read_token, a quote not closing a character literal
+         is read alone */
+      p += (p + 2 < end && p[2] == '\'') ? 3 : 1;
+      break;
+
+    default:
+      p++;
+      break;
+    }
+  }
+
+  chunks[n].begin = chunk_begin;
+  chunks[n].end = end;
+  chunks[n].line = chunk_line;
+  return n + 1;
+}
+
+static void lex_chunk(struct chunk *c)
+{
+  struct lexer ll = LEXER_INIT;
+
+  c->lex = ll;
+  c->lex.line = c->line;
+  c->lex.column = c->column;
+  c->lex.base = c->offset;
+  open_buffer_stream(&c->lex.strm, c->begin, c->end - c->begin);
+  c->n_tokens = tokenize_serial(&c->lex);
+}
+
+static void *chunk_worker(void *data)
+{
+  struct chunk_queue *queue = (struct chunk_queue *) data;
+
+  for (;;) {
+    struct chunk *c = NULL;
+
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->next < queue->n_chunks) {
+      c = &queue->chunks[queue->next++];
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (c == NULL) {
+      break;
+    }
+    lex_chunk(c);
+  }
+  return NULL;
+}
+
+/* concatenates the tokens of the chunks, dropping TK_EOS but the last */
+static int stitch_chunks(struct lexer *l, struct chunk *chunks, int n_chunks)
+{
+  int total = 1;
+  int i;
+
+  for (i = 0; i < n_chunks; i++) {
+    if (chunks[i].n_tokens == -1) {
+      return -1;
+    }
+    total += chunks[i].n_tokens - 1;
+  }
+
+  l->tokens = MEMORY_ALLOC_ARRAY(struct token, total);
+  if (l->tokens == NULL) {
+    return -1;
+  }
+  l->max_tokens = total;
+
+  for (i = 0; i < n_chunks; i++) {
+    struct lexer *cl = &chunks[i].lex;
+    const int n = i == n_chunks - 1 ? cl->n_tokens : cl->n_tokens - 1;
+
+    memcpy(l->tokens + l->n_tokens, cl->tokens, sizeof(struct token) * n);
+    l->n_tokens += n;
+    /* string literals of the chunk now belong to the whole input */
+    arena_take(&l->strings, &cl->strings);
+  }
+
+  /* chunks are lexed without the interner as it is not thread safe */
+  if (l->names != NULL) {
+    for (i = 0; i < l->n_tokens; i++) {
+      if (!intern_token(l->names, &l->tokens[i])) {
+        return -1;
+      }
+    }
+  }
+
+  l->line = chunks[n_chunks - 1].lex.line;
+  l->column = chunks[n_chunks - 1].lex.column;
+  l->tokcurr = -1;
+  return l->n_tokens;
+}
+
+int lex_tokenize_parallel(struct lexer *l, int n_chunks, int n_threads)
+{
+  struct chunk_queue queue;
+  struct chunk *chunks = NULL;
+  pthread_t *threads = NULL;
+  const size_t pos = stream_position(&l->strm);
+  const size_t size = stream_read_all(&l->strm) - pos;
+  const char *text = stream_text(&l->strm, pos);
+  int n_started = 0;
+  int result = 0;
+  int i;
+
+  if (n_chunks > MAX_CHUNKS) {
+    n_chunks = MAX_CHUNKS;
+  }
+  if (n_chunks < 2 || n_threads < 2) {
+    return tokenize_serial(l);
+  }
+
+  chunks = MEMORY_ALLOC_ARRAY(struct chunk, n_chunks);
+  threads = MEMORY_ALLOC_ARRAY(pthread_t, n_threads);
+  if (chunks == NULL || threads == NULL) {
+    MEMORY_FREE(chunks);
+    MEMORY_FREE(threads);
+    return tokenize_serial(l);
+  }
+
+  queue.chunks = chunks;
+  queue.n_chunks = split_chunks(text, text + size, l->line, chunks, n_chunks);
+  for (i = 0; i < queue.n_chunks; i++) {
+    /* chunks after the first start at the beginning of a line */
+    chunks[i].column = i == 0 ? l->column : 0;
+    chunks[i].offset = l->base + pos + (chunks[i].begin - text);
+  }
+  queue.next = 0;
+  pthread_mutex_init(&queue.mutex, NULL);
+
+  /* the calling thread is one of the workers */
+  for (i = 0; i < n_threads - 1 && i < queue.n_chunks - 1; i++) {
+    if (pthread_create(&threads[i], NULL, chunk_worker, &queue) != 0) {
+      break;
+    }
+    n_started++;
+  }
+  chunk_worker(&queue);
+  for (i = 0; i < n_started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&queue.mutex);
+
+  result = stitch_chunks(l, chunks, queue.n_chunks);
+
+  for (i = 0; i < queue.n_chunks; i++) {
+    lex_finish(&chunks[i].lex);
+  }
+  MEMORY_FREE(chunks);
+  MEMORY_FREE(threads);
+  return result;
+}
+
+int lex_tokenize(struct lexer *l)
+{
+  const size_t pos = stream_position(&l->strm);
+  const size_t size = stream_read_all(&l->strm) - pos;
+  const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (size < 2 * PARALLEL_CHUNK_SIZE || n_cpus < 2) {
+    return tokenize_serial(l);
+  }
+
+  return lex_tokenize_parallel(l, size / PARALLEL_CHUNK_SIZE, n_cpus);
+}
+
+/* the current token of the token array clamped to [0, n_tokens) */
+static const struct token *array_tok(const struct lexer *l, int i)
+{
+  if (i < 0) {
+    i = 0;
+  } else if (i >= l->n_tokens) {
+    i = l->n_tokens - 1;
+  }
+  return &l->tokens[i];
 }
 
 const struct token *lex_get_token(struct lexer *l)
 {
+  if (l->tokens != NULL) {
+    if (l->tokcurr < l->n_tokens - 1) {
+      l->tokcurr++;
+    }
+    return array_tok(l, l->tokcurr);
+  }
+
   if (l->is_head) {
     struct token tok;
     read_token(l, &tok);
@@ -531,6 +1011,13 @@ const struct token *lex_get_token(struct lexer *l)
 
 const struct token *lex_unget_token(struct lexer *l)
 {
+  if (l->tokens != NULL) {
+    if (l->tokcurr >= 0) {
+      l->tokcurr--;
+    }
+    return array_tok(l, l->tokcurr);
+  }
+
   if (l->is_head) {
     l->is_head = 0;
     bwd_tokbuf(l);
@@ -541,15 +1028,39 @@ const struct token *lex_unget_token(struct lexer *l)
 
 const struct token *lex_current_token(const struct lexer *l)
 {
+  if (l->tokens != NULL) {
+    return array_tok(l, l->tokcurr);
+  }
+
   return load_tok(l);
 }
 
+const struct token *lex_peek_token(struct lexer *l, int n)
+{
+  if (l->tokens != NULL) {
+    return array_tok(l, l->tokcurr + n);
+  } else {
+    /* the token ring only holds one token ahead */
+    const struct token *tok = lex_get_token(l);
+    lex_unget_token(l);
+    return tok;
+  }
+}
+
 int lex_get_line_num(const struct lexer *l)
 {
+  if (l->tokens != NULL) {
+    return line_of(array_tok(l, l->tokcurr));
+  }
+
   return l->line;
 }
 
 int lex_get_column_num(const struct lexer *l)
 {
+  if (l->tokens != NULL) {
+    return location_of(array_tok(l, l->tokcurr))->column;
+  }
+
   return l->column;
 }
@@ -6,6 +6,8 @@ See LICENSE and README
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "arena.h"
+#include "intern.h"
 #include "stream.h"
 #include "token.h"
 #include <stdio.h>
@@ -15,21 +17,45 @@ See LICENSE and README
 struct lexer {
   int line;
   int column;
+  /* byte offset in the source of the start of the stream */
+  unsigned int base;
   struct stream strm;
   struct token tokbuf[TOKBUF_SIZE];
   int tokcurr;
   int is_head;
+
+  /* filled by lex_tokenize. tokens[tokcurr] is the current token */
+  struct token *tokens;
+  int n_tokens;
+  int max_tokens;
+  /* decoded string literals. freed by lex_finish */
+  struct arena strings;
+  /* when set, identifiers, numbers and string literals are interned.
+     not owned by the lexer */
+  struct interner *names;
 };
 
-#define LEXER_INIT {1,0,STREAM_INIT,{TOKEN_INIT},0,1}
+#define LEXER_INIT {1,0,0,STREAM_INIT,{TOKEN_INIT},0,1,NULL,0,0,ARENA_INIT,NULL}
 
 extern int lex_input_string(struct lexer *l, const char *string);
 extern int lex_input_file(struct lexer *l, const char *filename);
+/* reads len bytes of text in place. text must outlive the lexer */
+extern int lex_input_buffer(struct lexer *l, const char *text, size_t len);
 extern void lex_finish(struct lexer *l);
 
+/* lexes the whole input into a token array up to and including TK_EOS.
+   returns the number of tokens, or -1 on memory allocation failure.
+   afterwards lex_get_token and friends read the array */
+extern int lex_tokenize(struct lexer *l);
+/* lex_tokenize on n_chunks pieces of the input with up to n_threads threads.
+   lex_tokenize calls this for large inputs */
+extern int lex_tokenize_parallel(struct lexer *l, int n_chunks, int n_threads);
+
 extern const struct token *lex_get_token(struct lexer *l);
 extern const struct token *lex_unget_token(struct lexer *l);
 extern const struct token *lex_current_token(const struct lexer *l);
+/* n tokens ahead of the current token without consuming them */
+extern const struct token *lex_peek_token(struct lexer *l, int n);
 
 extern int lex_get_line_num(const struct lexer *l);
 extern int lex_get_column_num(const struct lexer *l);
@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+/*
+  Generates keywords.h, a collision-free hash table over KEYWORD_LIST.
+  The hash is (len * A + first * B + last * C) & (SIZE - 1), and this program
+  searches the smallest SIZE and multipliers that put every keyword in its
+  own slot, so the lexer needs one hash and at most one compare per word.
+*/
+
+#include "token.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_TABLE_SIZE 1024
+#define MAX_MULTIPLIER 32
+
+static const struct keyword {
+  const char *tag;
+  const char *word;
+} keywords[] = {
+#define T(tag,str) {#tag, str},
+  KEYWORD_LIST(T)
+#undef T
+  {NULL, NULL}
+};
+static const int N_KEYWORDS = sizeof(keywords)/sizeof(keywords[0]) - 1;
+
+static unsigned int hash(const char *word, int a, int b, int c, int size)
+{
+  const int len = strlen(word);
+  const unsigned char first = word[0];
+  const unsigned char last = word[len - 1];
+
+  return (len * a + first * b + last * c) & (size - 1);
+}
+
+static int is_perfect(int a, int b, int c, int size)
+{
+  char used[MAX_TABLE_SIZE] = {0};
+  int i;
+
+  for (i = 0; i < N_KEYWORDS; i++) {
+    const unsigned int h = hash(keywords[i].word, a, b, c, size);
+    if (used[h]) {
+      return 0;
+    }
+    used[h] = 1;
+  }
+  return 1;
+}
+
+static void print_table(int a, int b, int c, int size)
+{
+  const struct keyword *slots[MAX_TABLE_SIZE] = {NULL};
+  int max_len = 0;
+  int i;
+
+  for (i = 0; i < N_KEYWORDS; i++) {
+    const int len = strlen(keywords[i].word);
+    slots[hash(keywords[i].word, a, b, c, size)] = &keywords[i];
+    if (max_len < len) {
+      max_len = len;
+    }
+  }
+
+  printf("/* generated by mkkeywords. do not edit */\n\n");
+  printf("#ifndef KEYWORDS_H\n");
+  printf("#define KEYWORDS_H\n\n");
+  printf("#define KEYWORD_TABLE_SIZE %d\n", size);
+  printf("#define KEYWORD_MAX_LEN %d\n\n", max_len);
+  printf("#define KEYWORD_HASH(word,len) \\\n");
+  printf("  (((len) * %d + \\\n", a);
+  printf("    (unsigned char) (word)[0] * %d + \\\n", b);
+  printf("    (unsigned char) (word)[(len) - 1] * %d) & %d)\n\n", c, size - 1);
+  printf("static const struct keyword {\n");
+  printf("  int id;\n");
+  printf("  int len;\n");
+  printf("  const char *word;\n");
+  printf("} keyword_table[KEYWORD_TABLE_SIZE] = {\n");
+  for (i = 0; i < size; i++) {
+    if (slots[i] == NULL) {
+      printf("  {0, 0, \"\"},\n");
+    } else {
+      printf("  {%s, %d, \"%s\"},\n",
+          slots[i]->tag, (int) strlen(slots[i]->word), slots[i]->word);
+    }
+  }
+  printf("};\n\n");
+  printf("#endif /* XXX_H */\n");
+}
+
+int main(void)
+{
+  int size;
+  int a, b, c;
+
+  for (size = 1; size < N_KEYWORDS; size *= 2) {
+  }
+
+  for (; size <= MAX_TABLE_SIZE; size *= 2) {
+    for (a = 1; a < MAX_MULTIPLIER; a++) {
+      for (b = 1; b < MAX_MULTIPLIER; b++) {
+        for (c = 1; c < MAX_MULTIPLIER; c++) {
+          if (is_perfect(a, b, c, size)) {
+            print_table(a, b, c, size);
+            return 0;
+          }
+        }
+      }
+    }
+  }
+
+  fprintf(stderr, "mkkeywords: no perfect hash found for the keywords\n");
+  return 1;
+}
@@ -15,8 +15,8 @@ typedef struct parser parser_t;
 
 static void syntax_error(parser_t *p, const char *msg)
 {
-  fprintf(stderr, "syntax error: %d, %s\n",
-        lex_get_line_num(&p->lex), msg);
+  fprintf(stderr, "syntax error: %d:%d, %s\n",
+        lex_get_line_num(&p->lex), lex_get_column_num(&p->lex), msg);
   exit(1);
 }
 
@@ -56,11 +56,11 @@ static int expect(parser_t *p, int kind)
   if (kind_of(tok) == kind) {
     return 1;
   } else {
-    fprintf(stderr, "syntak error: %d, expected '%s' but got '%s' [%s].\n",
-        lex_get_line_num(&p->lex),
+    fprintf(stderr, "syntak error: %d:%d, expected '%s' but got '%s' [%.*s].\n",
+        lex_get_line_num(&p->lex), lex_get_column_num(&p->lex),
         kind_to_string(kind),
         kind_to_string(tok->kind),
-        word_value_of(tok));
+        word_length_of(tok), word_value_of(tok));
     exit(1);
     return 0;
   }
@@ -77,39 +77,98 @@ static int next(parser_t *p, int kind)
   }
 }
 
-static node_t *list_node(node_t *current, node_t *next)
+static node_t *list_node(parser_t *p, node_t *current, node_t *next)
 {
-  return new_node(AST_LIST, current, next);
+  return new_node(p->nodes, AST_LIST, current, next);
+}
+
+/* where the token read last starts */
+static struct location here(parser_t *p)
+{
+  return *location_of(current_token(p));
+}
+
+static node_t *located(node_t *node, struct location loc)
+{
+  node->loc = loc;
+  return node;
 }
 
 static symbol_t *make_symbol(parser_t *p)
 {
   int kind = SYM_NONE;
   const token_t *tok = current_token(p);
+  symbol_t *sym = NULL;
 /*
   if (kind_of(tok) == TK_VAR) {
     kind = SYM_VAR;
   } else {
   }
 */
-  return add_symbol(p->symtbl, word_value_of(tok), kind);
+  sym = add_symbol(p->symtbl, word_value_of(tok), kind);
+  if (sym == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
+  return sym;
+}
+
+static void enter_scope(parser_t *p)
+{
+  if (!open_scope(p->symtbl)) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
 }
 
-static node_t *ast_number(parser_t *p, const char *number_string)
+static const struct constant *add_literal(parser_t *p, const struct constant *c)
 {
-  node_t *node = new_node(AST_LITERAL, NULL, NULL);
-  node->value.symbol = add_symbol(p->symtbl, number_string, SYM_NONE);
+  const struct constant *pooled = add_constant(p->consts, c);
+  if (pooled == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
+  return pooled;
+}
+
+static node_t *ast_number(parser_t *p, long value)
+{
+  char spelling[32] = {'\0'};
+  struct constant c;
+  node_t *node = new_node(p->nodes, AST_LITERAL, NULL, NULL);
+
+  sprintf(spelling, "%ld", value);
+  c.kind = TYPE_INT;
+  c.length = strlen(spelling);
+  c.spelling = intern(p->names, spelling, c.length);
+  if (c.spelling == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
+  c.value.Integer = value;
+  node->value.constant = add_literal(p, &c);
   return node;
 }
 
 static node_t *number(parser_t *p)
 {
+  const token_t *tok = NULL;
+  struct constant c;
   node_t *node = NULL;
   if (!expect(p, TK_NUMBER)) {
     return NULL;
   }
-  node = new_node(AST_LITERAL, NULL, NULL);
-  node->value.symbol = make_symbol(p);
+  tok = current_token(p);
+  c.kind = type_of(tok);
+  c.spelling = word_value_of(tok);
+  c.length = word_length_of(tok);
+  if (c.kind == TYPE_FLOAT || c.kind == TYPE_DOUBLE) {
+    c.value.Float = double_value_of(tok);
+  } else {
+    c.value.Integer = long_value_of(tok);
+  }
+  node = located(new_node(p->nodes, AST_LITERAL, NULL, NULL), *location_of(tok));
+  node->value.constant = add_literal(p, &c);
   return node;
 }
 
@@ -119,21 +178,44 @@ static node_t *identifier(parser_t *p)
   if (!expect(p, TK_IDENTIFIER)) {
     return NULL;
   }
-  node = new_node(AST_SYMBOL, NULL, NULL);
+  node = located(new_node(p->nodes, AST_SYMBOL, NULL, NULL), here(p));
   node->value.symbol = make_symbol(p);
   return node;
 }
 
+/* an identifier that declares a new symbol in the current scope */
+static node_t *declare_identifier(parser_t *p, int kind)
+{
+  const token_t *tok = NULL;
+  node_t *node = NULL;
+  if (!expect(p, TK_IDENTIFIER)) {
+    return NULL;
+  }
+  tok = current_token(p);
+  node = located(new_node(p->nodes, AST_SYMBOL, NULL, NULL), *location_of(tok));
+  node->value.symbol = define_symbol(p->symtbl, word_value_of(tok), kind);
+  if (node->value.symbol == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    exit(1);
+  }
+  return node;
+}
+
 node_t *string_literal(parser_t *p)
 {
   const token_t *tok = NULL;
+  struct constant c;
   node_t *sl = NULL;
   if (!expect(p, TK_STRING_LITERAL)) {
     return NULL;
   }
   tok = current_token(p);
-  sl = new_node(AST_STRING_LITERAL, NULL, NULL);
-  sl->value.symbol = add_symbol(p->symtbl, string_value_of(tok), SYM_LITERAL);
+  c.kind = TYPE_STRING;
+  c.spelling = string_value_of(tok);
+  c.length = word_length_of(tok);
+  c.value.Integer = 0;
+  sl = located(new_node(p->nodes, AST_STRING_LITERAL, NULL, NULL), *location_of(tok));
+  sl->value.constant = add_literal(p, &c);
   return sl;
 }
 
@@ -239,10 +321,7 @@ static void skip_until(parser_t *p, int until_tag)
 
 static int peek_token(parser_t *p)
 {
-  const token_t *tok = get_token(p);
-  const int kind = tok->kind;
-  unget_token(p);
-  return kind;
+  return kind_of(lex_peek_token(&p->lex, 1));
 }
 
 /* to avoid too many recursive calls for just simple list like statement_list */
@@ -252,7 +331,7 @@ typedef struct node_list {
 } node_list_t;
 #define INIT_NODE_LIST {NULL, NULL}
 
-static node_t *append(node_list_t *list, node_t *node)
+static node_t *append(parser_t *p, node_list_t *list, node_t *node)
 {
   if (node == NULL) {
     return NULL;
@@ -260,10 +339,10 @@ static node_t *append(node_list_t *list, node_t *node)
 
   if (list->tail == NULL) {
     /* the first append */
-    list->tail = list_node(node, NULL);
+    list->tail = list_node(p, node, NULL);
     list->head = list->tail;
   } else {
-    list->tail->rnode = list_node(node, NULL);
+    list->tail->rnode = list_node(p, node, NULL);
     list->tail = list->tail->rnode;
   }
   return node;
@@ -307,9 +386,7 @@ static struct type_info type_specifier(parser_t *p)
   if (next(p, '[')) {
     type.is_array = 1;
     if (next(p, TK_NUMBER)) {
-      char *end = NULL;
-      const token_t *tok = current_token(p);
-      type.array_size = strtol(word_value_of(tok), &end, 10);
+      type.array_size = long_value_of(current_token(p));
     }
     if (!expect(p, ']')) {
     }
@@ -406,23 +483,23 @@ static node_t *postfix_expression(parser_t *p)
 {
   node_t *node = primary_expression(p);
   if (next(p, TK_INC)) {
-    node = new_node(AST_POST_INC, node, NULL);
+    node = new_node(p->nodes, AST_POST_INC, node, NULL);
   }
   else if (next(p, TK_DEC)) {
-    node = new_node(AST_POST_DEC, node, NULL);
+    node = new_node(p->nodes, AST_POST_DEC, node, NULL);
   }
   else if (next(p, '[')) {
     node_t *expr = expression(p);
     if (!expect(p, ']')) {
     }
-    node = new_node(AST_SUBSCRIPT_EXPR, node, expr);
+    node = new_node(p->nodes, AST_SUBSCRIPT_EXPR, node, expr);
   }
   /* TODO TEST */
   else if (next(p, '(')) {
     node_t *args = argument_expression_list(p);
     if (!expect(p, ')')) {
     }
-    node = new_node(AST_CALL_EXPR, node, args);
+    node = new_node(p->nodes, AST_CALL_EXPR, node, args);
   }
   /* TODO END OF TEST */
   return node;
@@ -440,10 +517,12 @@ static node_t *unary_expression(parser_t *p)
 {
   node_t *node = NULL;
   if (next(p, TK_INC)) {
-    node = new_node(AST_PRE_INC, NULL, unary_expression(p));
+    const struct location loc = here(p);
+    node = located(new_node(p->nodes, AST_PRE_INC, NULL, unary_expression(p)), loc);
   }
   else if (next(p, TK_DEC)) {
-    node = new_node(AST_PRE_DEC, NULL, unary_expression(p));
+    const struct location loc = here(p);
+    node = located(new_node(p->nodes, AST_PRE_DEC, NULL, unary_expression(p)), loc);
   } else {
     node = postfix_expression(p);
   }
@@ -466,7 +545,7 @@ static node_t *multiplicative_expression(parser_t *p)
     else if (next(p, '/')) { new_op = AST_DIV; }
     else if (next(p, '%')) { new_op = AST_MOD; }
     else { break; }
-    node = new_node(new_op, node, unary_expression(p));
+    node = new_node(p->nodes, new_op, node, unary_expression(p));
   }
   return node;
 }
@@ -486,7 +565,7 @@ static node_t *additive_expression(parser_t *p)
     if      (next(p, '+')) { new_op = AST_ADD; }
     else if (next(p, '-')) { new_op = AST_SUB; }
     else { break; }
-    node = new_node(new_op, node, multiplicative_expression(p));
+    node = new_node(p->nodes, new_op, node, multiplicative_expression(p));
   }
   return node;
 }
@@ -506,7 +585,7 @@ static node_t *shift_expression(parser_t *p)
     if      (next(p, TK_LSHIFT)) { new_op = AST_LSHIFT; }
     else if (next(p, TK_RSHIFT)) { new_op = AST_RSHIFT; }
     else { break; }
-    node = new_node(new_op, node, additive_expression(p));
+    node = new_node(p->nodes, new_op, node, additive_expression(p));
   }
   return node;
 }
@@ -530,7 +609,7 @@ static node_t *relational_expression(parser_t *p)
     else if (next(p, TK_LE)) { new_op = AST_LE; }
     else if (next(p, TK_GE)) { new_op = AST_GE; }
     else { break; }
-    node = new_node(new_op, node, shift_expression(p));
+    node = new_node(p->nodes, new_op, node, shift_expression(p));
   }
   return node;
 }
@@ -550,7 +629,7 @@ static node_t *equality_expression(parser_t *p)
     if      (next(p, TK_EQ))   { new_op = AST_EQ; }
     else if (next(p, TK_NE))   { new_op = AST_NE; }
     else { break; }
-    node = new_node(new_op, node, relational_expression(p));
+    node = new_node(p->nodes, new_op, node, relational_expression(p));
   }
   return node;
 }
@@ -568,7 +647,7 @@ static node_t *bitwise_and_expression(parser_t *p)
     int new_op = AST_NUL;
     if (next(p, '&')) { new_op = AST_BITWISE_AND; }
     else { break; }
-    node = new_node(new_op, node, equality_expression(p));
+    node = new_node(p->nodes, new_op, node, equality_expression(p));
   }
   return node;
 }
@@ -586,7 +665,7 @@ static node_t *bitwise_xor_expression(parser_t *p)
     int new_op = AST_NUL;
     if (next(p, '^')) { new_op = AST_BITWISE_XOR; }
     else { break; }
-    node = new_node(new_op, node, bitwise_and_expression(p));
+    node = new_node(p->nodes, new_op, node, bitwise_and_expression(p));
   }
   return node;
 }
@@ -604,7 +683,7 @@ static node_t *bitwise_or_expression(parser_t *p)
     int new_op = AST_NUL;
     if (next(p, '|')) { new_op = AST_BITWISE_OR; }
     else { break; }
-    node = new_node(new_op, node, bitwise_xor_expression(p));
+    node = new_node(p->nodes, new_op, node, bitwise_xor_expression(p));
   }
   return node;
 }
@@ -622,7 +701,7 @@ static node_t *logical_and_expression(parser_t *p)
     int new_op = AST_NUL;
     if (next(p, TK_AND)) { new_op = AST_AND; }
     else { break; }
-    node = new_node(new_op, node, bitwise_or_expression(p));
+    node = new_node(p->nodes, new_op, node, bitwise_or_expression(p));
   }
   return node;
 }
@@ -640,7 +719,7 @@ static node_t *logical_or_expression(parser_t *p)
     int new_op = AST_NUL;
     if (next(p, TK_OR)) { new_op = AST_OR; }
     else { break; }
-    node = new_node(new_op, node, logical_and_expression(p));
+    node = new_node(p->nodes, new_op, node, logical_and_expression(p));
   }
   return node;
 }
@@ -667,7 +746,7 @@ static node_t *assignment_expression(parser_t *p)
   node_t *node = conditional_expression(p);
   for (;;) {
     if (next(p, '=')) {
-      node = new_node(AST_ASSIGN, node, assignment_expression(p));
+      node = new_node(p->nodes, AST_ASSIGN, node, assignment_expression(p));
     } else {
       break;
     }
@@ -701,13 +780,13 @@ static node_t *expression_statement(parser_t *p)
   node_t *expr = NULL;
 
   if (next(p, ';')) {
-    return new_node(AST_EXPR_STMT, NULL, NULL);
+    return located(new_node(p->nodes, AST_EXPR_STMT, NULL, NULL), here(p));
   }
  
   expr = expression(p);
   if (!expect(p, ';')) {
   }
-  return new_node(AST_EXPR_STMT, expr, NULL);
+  return new_node(p->nodes, AST_EXPR_STMT, expr, NULL);
 }
 
 /*
@@ -718,7 +797,7 @@ empty_statement
 static node_t *empty_statement(parser_t *p)
 {
   assert_next(p, ';');
-  return new_node(AST_EMPTY_STMT, NULL, NULL);
+  return located(new_node(p->nodes, AST_EMPTY_STMT, NULL, NULL), here(p));
 }
 
 /*
@@ -729,12 +808,14 @@ vardump_statement
 static node_t *vardump_statement(parser_t *p)
 {
   node_t *expr = NULL;
+  struct location loc;
 
   assert_next(p, TK_VARDUMP);
+  loc = here(p);
   expr = expression(p);
   if (!expect(p, ';')) {
   }
-  return new_node(AST_VARDUMP, expr, NULL);
+  return located(new_node(p->nodes, AST_VARDUMP, expr, NULL), loc);
 }
 
 /*
@@ -745,12 +826,14 @@ goto_statement
 static node_t *goto_statement(parser_t *p)
 {
   node_t *idnt = NULL;
+  struct location loc;
 
   assert_next(p, TK_GOTO);
+  loc = here(p);
   idnt = identifier(p);
   if (!expect(p, ';')) {
   }
-  return new_node(AST_GOTO, idnt, NULL);
+  return located(new_node(p->nodes, AST_GOTO, idnt, NULL), loc);
 }
 
 /*
@@ -762,8 +845,10 @@ static node_t *label_statement(parser_t *p)
 {
   node_t *stmt = NULL;
   node_t *idnt = NULL;
+  struct location loc;
 
   assert_next(p, TK_LABEL);
+  loc = here(p);
   idnt = identifier(p);
   if (!expect(p, ':')) {
   }
@@ -771,7 +856,7 @@ static node_t *label_statement(parser_t *p)
   if (stmt == NULL) {
     syntax_error(p, "labeled with no statement");
   }
-  return new_node(AST_LABEL, idnt, stmt);
+  return located(new_node(p->nodes, AST_LABEL, idnt, stmt), loc);
 }
 
 /*
@@ -783,8 +868,10 @@ static node_t *case_statement(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *stmt = NULL;
+  struct location loc;
 
   assert_next(p, TK_CASE);
+  loc = here(p);
   expr = expression(p);
   if (expr == NULL) {
     syntax_error(p, "missing expression");
@@ -795,7 +882,7 @@ static node_t *case_statement(parser_t *p)
   if (stmt == NULL) {
     syntax_error(p, "case labeled with no statement");
   }
-  return new_node(AST_CASE, expr, stmt);
+  return located(new_node(p->nodes, AST_CASE, expr, stmt), loc);
 }
 
 /*
@@ -806,15 +893,17 @@ default_statement
 static node_t *default_statement(parser_t *p)
 {
   node_t *stmt = NULL;
+  struct location loc;
 
   assert_next(p, TK_DEFAULT);
+  loc = here(p);
   if (!expect(p, ':')) {
   }
   stmt = statement(p);
   if (stmt == NULL) {
     syntax_error(p, "default labeled with no statement");
   }
-  return new_node(AST_DEFAULT, stmt, NULL);
+  return located(new_node(p->nodes, AST_DEFAULT, stmt, NULL), loc);
 }
 
 /*
@@ -828,7 +917,7 @@ static node_t *array_initializer(parser_t *p)
   for (;;) {
     node_t *expr = expression(p);
     if (expr == NULL) { break; }
-    append(&list, expr);
+    append(p, &list, expr);
 
     if (next(p, ',')) {
       continue;
@@ -866,9 +955,11 @@ static node_t *variable_declaration(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *idnt = NULL;
+  struct location loc;
 
   assert_next(p, TK_VAR);
-  idnt = identifier(p);
+  loc = here(p);
+  idnt = declare_identifier(p, SYM_VAR);
   idnt->value.symbol->type = type_specifier(p);
 
   if (next(p, '=')) {
@@ -879,12 +970,12 @@ static node_t *variable_declaration(parser_t *p)
   }
   if (expr == NULL) {
     /* TODO TMP */
-    expr = ast_number(p, "0");
+    expr = ast_number(p, 0);
   }
 
   if (!expect(p, ';')) {
   }
-  return new_node(AST_VAR_DECL, idnt, expr);
+  return located(new_node(p->nodes, AST_VAR_DECL, idnt, expr), loc);
 }
 
 /*
@@ -902,7 +993,7 @@ static node_t *variable_declaration_list(parser_t *p)
     return NULL;
   }
 
-  return list_node(decl, variable_declaration_list(p));
+  return list_node(p, decl, variable_declaration_list(p));
 }
 #endif
 
@@ -918,7 +1009,7 @@ static node_t *statement_list(parser_t *p)
   for (;;) {
     node_t *stmt = statement(p);
     if (stmt == NULL) { break; }
-    append(&list, stmt);
+    append(p, &list, stmt);
   }
   return list.head;
 }
@@ -931,14 +1022,18 @@ block_statement
 static node_t *block_statement(parser_t *p)
 {
   node_t *stmt_list = NULL;
+  struct location loc;
 
   if (!expect(p, '{')) {
   }
+  loc = here(p);
+  enter_scope(p);
   stmt_list = statement_list(p);
+  close_scope(p->symtbl);
 
   if (!expect(p, '}')) {
   }
-  return new_node(AST_COMPOUND, stmt_list, NULL);
+  return located(new_node(p->nodes, AST_COMPOUND, stmt_list, NULL), loc);
 }
 
 /*
@@ -951,7 +1046,7 @@ static node_t *break_statement(parser_t *p)
   node_t *stmt = NULL;
 
   assert_next(p, TK_BREAK);
-  stmt = new_node(AST_BREAK, NULL, NULL);
+  stmt = located(new_node(p->nodes, AST_BREAK, NULL, NULL), here(p));
   if (!expect(p, ';')) {
   }
   return stmt;
@@ -967,7 +1062,7 @@ static node_t *continue_statement(parser_t *p)
   node_t *stmt = NULL;
 
   assert_next(p, TK_CONTINUE);
-  stmt = new_node(AST_CONTINUE, NULL, NULL);
+  stmt = located(new_node(p->nodes, AST_CONTINUE, NULL, NULL), here(p));
   if (!expect(p, ';')) {
   }
   return stmt;
@@ -984,7 +1079,7 @@ static node_t *return_statement(parser_t *p)
   node_t *stmt = NULL;
 
   assert_next(p, TK_RETURN);
-  stmt = new_node(AST_RETURN, NULL, NULL);
+  stmt = located(new_node(p->nodes, AST_RETURN, NULL, NULL), here(p));
   if (next(p, ';')) {
     return stmt;
   }
@@ -1005,8 +1100,10 @@ static node_t *if_statement(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *then = NULL;
+  struct location loc;
 
   assert_next(p, TK_IF);
+  loc = here(p);
 
   if (!expect(p, '(')) {
   }
@@ -1015,13 +1112,13 @@ static node_t *if_statement(parser_t *p)
   if (!expect(p, ')')) {
   }
 
-  then = new_node(AST_THEN, statement(p), NULL);
+  then = new_node(p->nodes, AST_THEN, statement(p), NULL);
 
   if (next(p, TK_ELSE)) {
     then->rnode = statement(p);
   }
 
-  return new_node(AST_IF, expr, then);
+  return located(new_node(p->nodes, AST_IF, expr, then), loc);
 }
 
 #if 0
@@ -1064,10 +1161,10 @@ static node_t *case_clause(parser_t *p)
       break;
     }
 
-    append(&list, stmt);
+    append(p, &list, stmt);
   }
 
-  return new_node(NODE_CASE_STMT, expr, list.head);
+  return new_node(p->nodes, NODE_CASE_STMT, expr, list.head);
 #endif
   return NULL;
 }
@@ -1083,7 +1180,7 @@ static node_t *case_clause_list(parser_t *p)
   if (clause == NULL) {
     return NULL;
   }
-  return list_node(clause, case_clause_list(p));
+  return list_node(p, clause, case_clause_list(p));
 #if 0
   node_t *list = NULL;
   node_t *tail = NULL;
@@ -1093,14 +1190,14 @@ static node_t *case_clause_list(parser_t *p)
   if (clause == NULL) {
     return NULL;
   }
-  list = list_node(clause, NULL);
+  list = list_node(p, clause, NULL);
 
   for (;;) {
     clause = case_clause(p);
     if (clause == NULL) {
       break;
     }
-    tail->rnode = list_node(clause, NULL);
+    tail->rnode = list_node(p, clause, NULL);
     tail = tail->rnode;
   }
   return list;
@@ -1115,7 +1212,7 @@ static node_t *case_clause_list(parser_t *p)
       break;
     }
 
-    append(&list, case_clause(p));
+    append(p, &list, case_clause(p));
   }
 
   return list.head;
@@ -1133,8 +1230,10 @@ static node_t *switch_statement(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *stmt = NULL;
+  struct location loc;
 
   assert_next(p, TK_SWITCH);
+  loc = here(p);
   if (!expect(p, '(')) {
   }
 
@@ -1147,7 +1246,7 @@ static node_t *switch_statement(parser_t *p)
     syntax_error(p, "missing statement");
   }
 
-  return new_node(AST_SWITCH, expr, stmt);
+  return located(new_node(p->nodes, AST_SWITCH, expr, stmt), loc);
 }
 
 /*
@@ -1162,11 +1261,15 @@ static node_t *for_statement(parser_t *p)
   node_t *expr = NULL;
   node_t *body = NULL;
   node_t *iter = NULL;
+  struct location loc;
 
   assert_next(p, TK_FOR);
+  loc = here(p);
 
   if (!expect(p, '(')) {
   }
+  /* variables declared in the init statement belong to the loop */
+  enter_scope(p);
 
   if (peek_token(p) == TK_VAR) {
     init = statement(p);
@@ -1188,10 +1291,11 @@ static node_t *for_statement(parser_t *p)
   if (!expect(p, ')')) {
   }
 
-  body = new_node(AST_FOR_BODY, iter, statement(p));
-  cond = new_node(AST_FOR_COND, expr, body);
+  body = new_node(p->nodes, AST_FOR_BODY, iter, statement(p));
+  cond = new_node(p->nodes, AST_FOR_COND, expr, body);
+  close_scope(p->symtbl);
 
-  return new_node(AST_FOR_INIT, init, cond);
+  return located(new_node(p->nodes, AST_FOR_INIT, init, cond), loc);
 }
 
 /*
@@ -1203,8 +1307,10 @@ static node_t *while_statement(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *stmt = NULL;
+  struct location loc;
 
   assert_next(p, TK_WHILE);
+  loc = here(p);
   if (!expect(p, '(')) {
   }
   expr = expression(p);
@@ -1212,7 +1318,7 @@ static node_t *while_statement(parser_t *p)
   }
 
   stmt = statement(p);
-  return new_node(AST_WHILE, expr, stmt);
+  return located(new_node(p->nodes, AST_WHILE, expr, stmt), loc);
 }
 
 /*
@@ -1224,8 +1330,10 @@ static node_t *do_while_statement(parser_t *p)
 {
   node_t *expr = NULL;
   node_t *stmt = NULL;
+  struct location loc;
 
   assert_next(p, TK_DO);
+  loc = here(p);
 
   stmt = statement(p);
   if (!expect(p, TK_WHILE)) {
@@ -1240,7 +1348,7 @@ static node_t *do_while_statement(parser_t *p)
   if (!expect(p, ';')) {
   }
 
-  return new_node(AST_DO_WHILE, stmt, expr);
+  return located(new_node(p->nodes, AST_DO_WHILE, stmt, expr), loc);
 }
 
 /*
@@ -1348,15 +1456,20 @@ static node_t *function_definition(parser_t *p)
   node_t *func_def = NULL;
   node_t *func_body = NULL;
   node_t *idnt = NULL;
+  struct location loc;
 
   assert_next(p, TK_FN);
-  idnt = identifier(p);
-  func_def = new_node(AST_FN_DEF, idnt, NULL);
-  func_body = new_node(AST_FN_BODY, NULL, NULL);
+  loc = here(p);
+  idnt = declare_identifier(p, SYM_FUNCTION);
+  func_def = located(new_node(p->nodes, AST_FN_DEF, idnt, NULL), loc);
+  func_body = located(new_node(p->nodes, AST_FN_BODY, NULL, NULL), loc);
 
+  /* the function scope holds the parameters */
+  enter_scope(p);
   func_body->lnode = function_parameters(p);
   idnt->value.symbol->type = type_specifier(p);
   func_body->rnode = function_body(p);
+  close_scope(p->symtbl);
 
   func_def->rnode = func_body;
   return func_def;
@@ -1376,14 +1489,13 @@ static node_t *enumerator(parser_t *p)
   if (peek_token(p) != TK_IDENTIFIER) {
     return NULL;
   }
-  idnt = identifier(p);
-  idnt->value.symbol->kind = SYM_ENUMERATOR;
+  idnt = declare_identifier(p, SYM_ENUMERATOR);
 
   if (next(p, '=')) {
     expr = expression(p);
   }
 
-  enm = new_node(AST_ENUMERATOR, idnt, expr);
+  enm = new_node(p->nodes, AST_ENUMERATOR, idnt, expr);
 
   if (!expect(p, ';')) {
   }
@@ -1403,7 +1515,7 @@ static node_t *enumerator_list(parser_t *p)
   for (;;) {
     node_t *enm = enumerator(p);
     if (enm == NULL) { break; }
-    append(&list, enm);
+    append(p, &list, enm);
   }
   return list.head;
 }
@@ -1417,8 +1529,10 @@ static node_t *enumeration_declaration(parser_t *p)
 {
   node_t *enum_list = NULL;
   node_t *enum_idnt = NULL;
+  struct location loc;
 
   assert_next(p, TK_ENUM);
+  loc = here(p);
   enum_idnt = identifier(p);
 
   if (!expect(p, '{')) {
@@ -1429,7 +1543,7 @@ static node_t *enumeration_declaration(parser_t *p)
 
   if (!expect(p, ';')) {
   }
-  return new_node(AST_ENUM_DEF, enum_idnt, enum_list);
+  return located(new_node(p->nodes, AST_ENUM_DEF, enum_idnt, enum_list), loc);
 }
 
 /*
@@ -1465,7 +1579,7 @@ static node_t *external_declaration_list(parser_t *p)
   for (;;) {
     node_t *decl = external_declaration(p);
     if (decl == NULL) { break; }
-    append(&list, decl);
+    append(p, &list, decl);
   }
   return list.head;
 }
@@ -1486,10 +1600,56 @@ static node_t *program(parser_t *p)
   */
 }
 
+/* lexes and parses the input of p->lex */
+static struct ast_node *parse_input(struct parser *p, const char *filename)
+{
+  struct ast_node *node = NULL;
+
+  /* lex_tokenize reads the rest of the input itself when not timed */
+  if (p->times != NULL) {
+    report_begin(p->times);
+    stream_read_all(&p->lex.strm);
+    report_end(p->times, PHASE_READ);
+  }
+
+  report_begin(p->times);
+  p->lex.names = p->names;
+  if (lex_tokenize(&p->lex) == -1) {
+    fprintf(stderr, "error: %s: out of memory\n", filename);
+    exit(1);
+  }
+  report_end(p->times, PHASE_LEX);
+
+  report_begin(p->times);
+  node = program(p);
+  report_end(p->times, PHASE_PARSE);
+
+  if (p->times != NULL) {
+    p->times->n_files++;
+    p->times->n_tokens += p->lex.n_tokens;
+    p->times->n_symbols += symbol_count(p->symtbl);
+    p->times->n_symbol_slots += symbol_capacity(p->symtbl);
+  }
+  return node;
+}
+
 struct ast_node *parse_file(struct parser *p, const char *filename)
 {
-  lex_input_file(&p->lex, filename);
-  return program(p);
+  report_begin(p->times);
+  if (lex_input_file(&p->lex, filename)) {
+    fprintf(stderr, "error: %s: could not open file\n", filename);
+    exit(1);
+  }
+  report_end(p->times, PHASE_OPEN);
+
+  return parse_input(p, filename);
+}
+
+struct ast_node *parse_buffer(struct parser *p, const char *filename,
+    const char *text, size_t len)
+{
+  lex_input_buffer(&p->lex, text, len);
+  return parse_input(p, filename);
 }
 
 void parse_finish(struct parser *p)
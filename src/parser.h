@@ -7,17 +7,30 @@ See LICENSE and README
 #define PARSER_H
 
 #include "ast.h"
+#include "constant.h"
 #include "lexer.h"
+#include "report.h"
 #include "symbol.h"
 
 struct parser {
   struct lexer lex;
   struct symbol_table *symtbl;
+  /* names of tokens and symbols. not owned by the parser */
+  struct interner *names;
+  /* literals. not owned by the parser */
+  struct constant_pool *consts;
+  /* the ast. not owned by the parser */
+  struct arena *nodes;
+  /* times the phases of parse_file when set. not owned by the parser */
+  struct time_report *times;
 };
 
-#define PARSER_INIT {LEXER_INIT}
+#define PARSER_INIT {LEXER_INIT,NULL,NULL,NULL,NULL,NULL}
 
 extern struct ast_node *parse_file(struct parser *p, const char *filename);
+/* parses len bytes of text in place, naming filename in errors */
+extern struct ast_node *parse_buffer(struct parser *p, const char *filename,
+    const char *text, size_t len);
 extern void parse_finish(struct parser *p);
 
 #if 0
@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "report.h"
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const char *const phase_names[] = {
+#define T(tag,str) str,
+  PHASE_LIST(T)
+#undef T
+};
+
+/* fail to compile when the table gets out of sync with the phases */
+typedef char phase_names_cover_phases[
+    sizeof(phase_names)/sizeof(phase_names[0]) == PHASE_END ? 1 : -1];
+
+static double wall_seconds(void)
+{
+  struct timespec t;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
+    return 0;
+  }
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double timeval_seconds(const struct timeval *t)
+{
+  return t->tv_sec + t->tv_usec / 1e6;
+}
+
+/* cpu seconds of ec and its waited children, and the ru_maxrss of either */
+static double cpu_seconds(unsigned long *maxrss)
+{
+  struct rusage self;
+  struct rusage children;
+
+  if (getrusage(RUSAGE_SELF, &self) != 0 ||
+      getrusage(RUSAGE_CHILDREN, &children) != 0) {
+    *maxrss = 0;
+    return 0;
+  }
+  /* ru_maxrss is in KiB */
+  *maxrss = 1024UL * (unsigned long)
+      (self.ru_maxrss > children.ru_maxrss ? self.ru_maxrss : children.ru_maxrss);
+  return timeval_seconds(&self.ru_utime) + timeval_seconds(&self.ru_stime) +
+      timeval_seconds(&children.ru_utime) + timeval_seconds(&children.ru_stime);
+}
+
+void report_init(struct time_report *r)
+{
+  unsigned long maxrss = 0;
+
+  if (r == NULL) {
+    return;
+  }
+  memset(r, 0, sizeof(*r));
+  r->start_wall = wall_seconds();
+  r->start_cpu = cpu_seconds(&maxrss);
+  r->phase_wall = r->start_wall;
+  r->phase_cpu = r->start_cpu;
+}
+
+void report_begin(struct time_report *r)
+{
+  unsigned long maxrss = 0;
+
+  if (r == NULL) {
+    return;
+  }
+  r->phase_wall = wall_seconds();
+  r->phase_cpu = cpu_seconds(&maxrss);
+}
+
+void report_end(struct time_report *r, enum phase ph)
+{
+  struct phase_time *t = NULL;
+  unsigned long maxrss = 0;
+  double cpu = 0;
+
+  if (r == NULL) {
+    return;
+  }
+  t = &r->phases[ph];
+  cpu = cpu_seconds(&maxrss);
+  t->wall += wall_seconds() - r->phase_wall;
+  t->cpu += cpu - r->phase_cpu;
+  if (t->maxrss_so_far < maxrss) {
+    t->maxrss_so_far = maxrss;
+  }
+}
+
+static void add_time(struct phase_time *dst, const struct phase_time *src)
+{
+  dst->wall += src->wall;
+  dst->cpu += src->cpu;
+  if (dst->maxrss_so_far < src->maxrss_so_far) {
+    dst->maxrss_so_far = src->maxrss_so_far;
+  }
+}
+
+void report_merge(struct time_report *dst, const struct time_report *src)
+{
+  int i;
+
+  if (dst == NULL) {
+    return;
+  }
+  for (i = 0; i < PHASE_END; i++) {
+    add_time(&dst->phases[i], &src->phases[i]);
+  }
+  dst->n_files += src->n_files;
+  dst->n_tokens += src->n_tokens;
+  dst->n_nodes += src->n_nodes;
+  dst->n_symbols += src->n_symbols;
+  dst->n_symbol_slots += src->n_symbol_slots;
+}
+
+void report_finish(struct time_report *r)
+{
+  unsigned long maxrss = 0;
+  double cpu = 0;
+
+  if (r == NULL) {
+    return;
+  }
+  cpu = cpu_seconds(&maxrss);
+  r->total.wall = wall_seconds() - r->start_wall;
+  r->total.cpu = cpu - r->start_cpu;
+  r->total.maxrss_so_far = maxrss;
+}
+
+/* symbols over the slots of all the symbol tables */
+static double load_factor(const struct time_report *r)
+{
+  return r->n_symbol_slots > 0 ? (double) r->n_symbols / r->n_symbol_slots : 0;
+}
+
+static void print_text(const struct time_report *r, FILE *fp)
+{
+  int i;
+
+  fprintf(fp, "%-8s %10s %10s %18s\n", "phase", "wall s", "cpu s", "maxrss so far KiB");
+  for (i = 0; i < PHASE_END; i++) {
+    const struct phase_time *t = &r->phases[i];
+    fprintf(fp, "%-8s %10.6f %10.6f %18lu\n",
+        phase_names[i], t->wall, t->cpu, t->maxrss_so_far / 1024);
+  }
+  fprintf(fp, "%-8s %10.6f %10.6f %18lu\n",
+      "total", r->total.wall, r->total.cpu, r->total.maxrss_so_far / 1024);
+  fprintf(fp, "files %lu, tokens %lu, nodes %lu, symbols %lu\n",
+      r->n_files, r->n_tokens, r->n_nodes, r->n_symbols);
+  fprintf(fp, "symbol table load factor %.4f (%lu/%lu slots)\n",
+      load_factor(r), r->n_symbols, r->n_symbol_slots);
+}
+
+static void print_json_time(const struct phase_time *t, FILE *fp)
+{
+  fprintf(fp, "{\"wall\": %.6f, \"cpu\": %.6f, \"maxrss_so_far_bytes\": %lu}",
+      t->wall, t->cpu, t->maxrss_so_far);
+}
+
+static void print_json(const struct time_report *r, FILE *fp)
+{
+  int i;
+
+  fprintf(fp, "{\"phases\": {");
+  for (i = 0; i < PHASE_END; i++) {
+    fprintf(fp, "%s\"%s\": ", i > 0 ? ", " : "", phase_names[i]);
+    print_json_time(&r->phases[i], fp);
+  }
+  fprintf(fp, "}, \"total\": ");
+  print_json_time(&r->total, fp);
+  fprintf(fp, ", \"files\": %lu, \"tokens\": %lu, \"nodes\": %lu, "
+      "\"symbols\": %lu, \"symbol_slots\": %lu, \"symbol_load_factor\": %.6f}\n",
+      r->n_files, r->n_tokens, r->n_nodes, r->n_symbols, r->n_symbol_slots,
+      load_factor(r));
+}
+
+void report_print(const struct time_report *r, enum report_format format,
+    FILE *fp)
+{
+  if (r == NULL) {
+    return;
+  }
+  if (format == REPORT_JSON) {
+    print_json(r, fp);
+  } else if (format == REPORT_TEXT) {
+    print_text(r, fp);
+  }
+}
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+
+#define PHASE_LIST(T) \
+  T(PHASE_OPEN, "open") \
+  T(PHASE_READ, "read") \
+  T(PHASE_LEX, "lex") \
+  T(PHASE_PARSE, "parse") \
+  T(PHASE_CODEGEN, "codegen") \
+  T(PHASE_CC, "cc") \
+  T(PHASE_LINK, "link")
+
+enum phase {
+#define T(tag,str) tag,
+  PHASE_LIST(T)
+#undef T
+  PHASE_END
+};
+
+enum report_format {
+  REPORT_NONE = 0,
+  REPORT_TEXT,
+  REPORT_JSON
+};
+
+/* cpu counts user and system time of ec and of the commands it waited
+   for, such as cc. maxrss_so_far is ru_maxrss in bytes at the end of the
+   phase: the largest resident size of ec or of a command since the run
+   began, not the peak of the phase alone */
+struct phase_time {
+  double wall;
+  double cpu;
+  unsigned long maxrss_so_far;
+};
+
+/*
+  Where a compilation spends its time. Phases do not nest, so a report
+  times one phase at a time between report_begin and report_end. All
+  functions do nothing on a NULL report, so callers pass one only when
+  the report is wanted.
+*/
+struct time_report {
+  struct phase_time phases[PHASE_END];
+  /* the whole run, set by report_finish */
+  struct phase_time total;
+  unsigned long n_files;
+  unsigned long n_tokens;
+  unsigned long n_nodes;
+  unsigned long n_symbols;
+  unsigned long n_symbol_slots;
+  /* when the run and the current phase began */
+  double start_wall;
+  double start_cpu;
+  double phase_wall;
+  double phase_cpu;
+};
+
+extern void report_init(struct time_report *r);
+extern void report_begin(struct time_report *r);
+extern void report_end(struct time_report *r, enum phase ph);
+/* adds the phases and counts of src, e.g. from another process. phases
+   run in parallel add up to more than the wall time of the run */
+extern void report_merge(struct time_report *dst, const struct time_report *src);
+/* measures the total up to now */
+extern void report_finish(struct time_report *r);
+
+extern void report_print(const struct time_report *r, enum report_format format,
+    FILE *fp);
+
+#endif /* XXX_H */
@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#include "scan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#define BLOCK_SIZE 16
+#endif
+
+static int is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\v';
+}
+
+static int is_identifier(char c)
+{
+  return (c >= '0' && c <= '9') ||
+         (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z') ||
+         c == '_';
+}
+
+#ifdef SCAN_SSE2
+/* index of the lowest set bit. mask must not be 0 */
+static int first_bit(unsigned int mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/* bytes of v within [lo, hi] for lo and hi in the ASCII range */
+static __m128i in_range(__m128i v, char lo, char hi)
+{
+  return _mm_and_si128(
+      _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+      _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+#endif
+
+const char *scan_blanks(const char *p, const char *end)
+{
+#ifdef SCAN_SSE2
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i vtab = _mm_set1_epi8('\v');
+
+  while (end - p >= BLOCK_SIZE) {
+    const __m128i v = _mm_loadu_si128((const __m128i *) p);
+    const __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+        _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, vtab)));
+    const unsigned int mask = _mm_movemask_epi8(m);
+
+    if (mask != 0xFFFF) {
+      return p + first_bit(~mask);
+    }
+    p += BLOCK_SIZE;
+  }
+#endif
+  while (p != end && is_blank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+const char *scan_identifier(const char *p, const char *end)
+{
+#ifdef SCAN_SSE2
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i under = _mm_set1_epi8('_');
+
+  while (end - p >= BLOCK_SIZE) {
+    const __m128i v = _mm_loadu_si128((const __m128i *) p);
+    /* folds upper case onto lower case */
+    const __m128i alpha = in_range(_mm_or_si128(v, lower), 'a', 'z');
+    const __m128i m = _mm_or_si128(alpha,
+        _mm_or_si128(in_range(v, '0', '9'), _mm_cmpeq_epi8(v, under)));
+    const unsigned int mask = _mm_movemask_epi8(m);
+
+    if (mask != 0xFFFF) {
+      return p + first_bit(~mask);
+    }
+    p += BLOCK_SIZE;
+  }
+#endif
+  while (p != end && is_identifier(*p)) {
+    p++;
+  }
+  return p;
+}
+
+const char *scan_line_comment(const char *p, const char *end)
+{
+#ifdef SCAN_SSE2
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  while (end - p >= BLOCK_SIZE) {
+    const __m128i v = _mm_loadu_si128((const __m128i *) p);
+    const unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+
+    if (mask != 0) {
+      return p + first_bit(mask);
+    }
+    p += BLOCK_SIZE;
+  }
+#endif
+  while (p != end && *p != '\n') {
+    p++;
+  }
+  return p;
+}
+
+/* checks one '*' or '\n' at p. returns the end of comment or NULL */
+static const char *block_comment_char(const char *p, const char *end,
+    int *closed, int *n_lines, const char **last_line)
+{
+  if (*p == '\n') {
+    (*n_lines)++;
+    *last_line = p;
+  } else if (*p == '*') {
+    if (p + 1 == end) {
+      return p;
+    }
+    if (p[1] == '/') {
+      *closed = 1;
+      return p + 2;
+    }
+  }
+  return NULL;
+}
+
+const char *scan_block_comment(const char *p, const char *end,
+    int *closed, int *n_lines, const char **last_line)
+{
+  const char *found = NULL;
+
+  *closed = 0;
+  *n_lines = 0;
+
+#ifdef SCAN_SSE2
+  {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (end - p >= BLOCK_SIZE) {
+      const __m128i v = _mm_loadu_si128((const __m128i *) p);
+      unsigned int mask = _mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(v, newline)));
+
+      while (mask != 0) {
+        found = block_comment_char(p + first_bit(mask), end,
+            closed, n_lines, last_line);
+        if (found != NULL) {
+          return found;
+        }
+        mask &= mask - 1;
+      }
+      p += BLOCK_SIZE;
+    }
+  }
+#endif
+  for (; p != end; p++) {
+    found = block_comment_char(p, end, closed, n_lines, last_line);
+    if (found != NULL) {
+      return found;
+    }
+  }
+  return p;
+}
@@ -0,0 +1,31 @@
+/*
+Copyright (c) 2012-2015 Hiroshi Tsubokawa
+See LICENSE and README
+*/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+/*
+  Bulk scanners over in-memory text for the lexer. Each scans [p, end) and
+  returns where the run stops. They use SSE2 16 bytes at a time when the
+  compiler targets it and plain loops otherwise.
+*/
+
+/* skips ' ', '\t' and '\v' */
+extern const char *scan_blanks(const char *p, const char *end);
+
+/* skips [0-9A-Za-z_] */
+extern const char *scan_identifier(const char *p, const char *end);
+
+/* finds the newline ending a line comment, or end */
+extern const char *scan_line_comment(const char *p, const char *end);
+
+/* finds the end of a block comment body and returns just after the closing
+   star and slash. if the comment does not close before end, sets *closed
+   to 0 and returns end, or a trailing '*' that may close after end.
+   counts newlines in *n_lines and points *last_line at the last one */
+extern const char *scan_block_comment(const char *p, const char *end,
+    int *closed, int *n_lines, const char **last_line);
+
+#endif /* XXX_H */
@@ -3,45 +3,79 @@ Copyright (c) 2012-2015 Hiroshi Tsubokawa
 See LICENSE and README
 */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "stream.h"
 #include "memory.h"
 #include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-static int get_ch(struct stream *s)
+static int retire_buffer(struct stream *s)
 {
-  switch (s->type) {
-  case STREAM_FILE:
-    return fgetc(s->file);
-  case STREAM_STRING:
-    return s->text[s->text_i];
-  default:
+  char **retired = NULL;
+
+  if (s->text == NULL)
+    return 1;
+
+  retired = MEMORY_REALLOC_ARRAY(s->retired, char *, s->n_retired + 1);
+  if (retired == NULL)
     return 0;
-  }
-}
 
-static void store_ch(struct stream *s, char c)
-{
-  s->bucket_i = (s->bucket_i + 1) % BUCKET_SIZE;
-  s->bucket[s->bucket_i] = c;
-  s->text_i++;
+  retired[s->n_retired++] = s->text;
+  s->retired = retired;
+  return 1;
 }
 
-static char fwd_ch(struct stream *s)
+/* appends the next chunk of STREAM_FILE to the window.
+   returns the number of bytes added, 0 at the end of the input */
+static size_t fill_buffer(struct stream *s)
 {
-  char c = '\0';
-  s->bucket_i = (s->bucket_i + 1) % BUCKET_SIZE;
-  c = s->bucket[s->bucket_i];
-  s->behind--;
-  return c;
-}
+  const size_t used = s->end - s->begin;
+  const size_t pos = s->curr - s->begin;
+  ssize_t nread = 0;
 
-static char bwd_ch(struct stream *s)
-{
-  char c = '\0';
-  s->bucket_i = (s->bucket_i - 1 + BUCKET_SIZE) % BUCKET_SIZE;
-  c = s->bucket[s->bucket_i];
-  s->behind++;
-  return c;
+  if (s->type != STREAM_FILE || s->is_eof)
+    return 0;
+
+  if (s->text_size - used < STREAM_CHUNK_SIZE) {
+    size_t new_size = s->text_size * 2;
+    char *new_text = NULL;
+
+    if (new_size < used + STREAM_CHUNK_SIZE)
+      new_size = used + STREAM_CHUNK_SIZE;
+
+    /* the old buffer is retired rather than reallocated
+       as earlier tokens may still point into it */
+    new_text = MEMORY_ALLOC_ARRAY(char, new_size);
+    if (new_text == NULL || !retire_buffer(s)) {
+      MEMORY_FREE(new_text);
+      s->is_eof = 1;
+      return 0;
+    }
+    if (used > 0)
+      memcpy(new_text, s->begin, used);
+    s->text = new_text;
+    s->text_size = new_size;
+    s->begin = s->text;
+    s->curr = s->begin + pos;
+    s->end = s->begin + used;
+  }
+
+  do {
+    nread = read(s->fd, s->text + used, STREAM_CHUNK_SIZE);
+  } while (nread == -1 && errno == EINTR);
+
+  if (nread <= 0) {
+    s->is_eof = 1;
+    return 0;
+  }
+
+  s->end += nread;
+  return nread;
 }
 
 int open_string_stream(struct stream *s, const char *string)
@@ -51,56 +85,159 @@ int open_string_stream(struct stream *s, const char *string)
 
   strm.type = STREAM_STRING;
   strm.text = MEMORY_ALLOC_ARRAY(char, len + 1);
+  if (strm.text == NULL)
+    return -1;
   strncpy(strm.text, string, len + 1);
 
+  strm.text_size = len + 1;
+  strm.begin = strm.text;
+  strm.curr = strm.begin;
+  strm.end = strm.begin + len;
+
   *s = strm;
   return 0;
 }
 
-int open_file_stream(struct stream *s, const char *filename)
+int open_buffer_stream(struct stream *s, const char *text, size_t len)
 {
+  struct stream strm = STREAM_INIT;
+
+  strm.type = STREAM_STRING;
+  strm.begin = text;
+  strm.curr = strm.begin;
+  strm.end = strm.begin + len;
+
+  *s = strm;
+  return 0;
+}
 
+int open_fd_stream(struct stream *s, int fd)
+{
   struct stream strm = STREAM_INIT;
 
+  if (fd < 0)
+    return -1;
+
   strm.type = STREAM_FILE;
-  strm.file = fopen(filename, "r");
+  strm.fd = fd;
 
-  if (strm.file == NULL)
+  *s = strm;
+  return 0;
+}
+
+int open_file_stream(struct stream *s, const char *filename)
+{
+  const int fd = open(filename, O_RDONLY);
+
+  if (open_fd_stream(s, fd))
     return -1;
 
+  s->owns_fd = 1;
+  return 0;
+}
+
+int open_mmap_stream(struct stream *s, const char *filename)
+{
+  struct stream strm = STREAM_INIT;
+  struct stat st;
+  void *map = NULL;
+  int fd = -1;
+
+  fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return -1;
+
+  /* pipes, devices and empty files can not be mapped */
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED)
+    return -1;
+
+  strm.type = STREAM_MMAP;
+  strm.map_size = st.st_size;
+  strm.begin = (const char *) map;
+  strm.curr = strm.begin;
+  strm.end = strm.begin + strm.map_size;
+
   *s = strm;
   return 0;
 }
 
 void close_stream(struct stream *s)
 {
-  if (s->file != NULL)
-    fclose(s->file);
+  if (s->type == STREAM_MMAP)
+    munmap((void *) s->begin, s->map_size);
+
+  if (s->owns_fd)
+    close(s->fd);
 
   if (s->text != NULL)
     MEMORY_FREE(s->text);
+
+  if (s->retired != NULL) {
+    int i;
+    for (i = 0; i < s->n_retired; i++) {
+      MEMORY_FREE(s->retired[i]);
+    }
+    MEMORY_FREE(s->retired);
+  }
 }
 
 char stream_getc(struct stream *s)
 {
-  int c = '\0';
-
-  if (s->behind > 0) {
-    c = fwd_ch(s);
-    return (char) c;
+  if (s->curr == s->end && fill_buffer(s) == 0) {
+    s->n_end_reads++;
+    return '\0';
   }
 
-  c = get_ch(s);
+  return *s->curr++;
+}
 
-  if (c > 0) {
-    store_ch(s, c);
-    return (char) c;
-  } else {
+char stream_ungetc(struct stream *s)
+{
+  /* the '\0' for the end was not read from the text */
+  if (s->n_end_reads > 0) {
+    s->n_end_reads--;
+    return s->curr == s->begin ? '\0' : s->curr[-1];
+  }
+  if (s->curr == s->begin)
     return '\0';
+
+  s->curr--;
+  return s->curr == s->begin ? '\0' : s->curr[-1];
+}
+
+size_t stream_read_all(struct stream *s)
+{
+  while (fill_buffer(s) > 0) {
   }
+
+  return s->end - s->begin;
 }
 
-char stream_ungetc(struct stream *s)
+size_t stream_position(const struct stream *s)
+{
+  return s->curr - s->begin;
+}
+
+const char *stream_text(const struct stream *s, size_t pos)
+{
+  return s->begin + pos;
+}
+
+const char *stream_window(const struct stream *s, const char **end)
+{
+  *end = s->end;
+  return s->curr;
+}
+
+void stream_skip(struct stream *s, size_t n)
 {
-  return bwd_ch(s);
+  s->curr += n;
 }
@@ -7,34 +7,75 @@ See LICENSE and README
 #define STREAM_H
 
 #include <stdio.h>
+#include <stddef.h>
 
-#define BUCKET_SIZE 32
+/* bytes requested by each read(2) on STREAM_FILE */
+#define STREAM_CHUNK_SIZE (64 * 1024)
 
 enum {
   STREAM_NONE = 0,
   STREAM_STRING,
-  STREAM_FILE
+  STREAM_FILE,
+  STREAM_MMAP
 };
 
+/*
+  Every stream type reads from the window [begin, end), so getc and ungetc
+  are pointer moves. STREAM_FILE appends chunks to the window on demand and
+  never drops what it has read, so ungetc has no lookahead limit.
+  Text returned by stream_text stays valid until close_stream.
+*/
 struct stream {
   int type;
 
+  const char *begin;
+  const char *curr;
+  const char *end;
+  /* stream_getc calls at the end, which did not advance */
+  int n_end_reads;
+
+  /* STREAM_STRING and STREAM_FILE own the buffer */
   char *text;
-  int text_i;
-  FILE *file;
+  size_t text_size;
 
-  char bucket[BUCKET_SIZE];
-  int bucket_i;
-  int behind;
+  /* STREAM_FILE */
+  int fd;
+  int owns_fd;
+  int is_eof;
+  /* outgrown buffers still referenced by stream_text */
+  char **retired;
+  int n_retired;
+
+  /* STREAM_MMAP */
+  size_t map_size;
 };
 
-#define STREAM_INIT {STREAM_NONE,NULL,0,NULL,{0},0,0}
+#define STREAM_INIT {STREAM_NONE,NULL,NULL,NULL,0,NULL,0,-1,0,0,NULL,0,0}
 
 extern int open_string_stream(struct stream *s, const char *string);
+/* reads len bytes of text in place. text must outlive the stream */
+extern int open_buffer_stream(struct stream *s, const char *text, size_t len);
 extern int open_file_stream(struct stream *s, const char *filename);
+extern int open_fd_stream(struct stream *s, int fd);
+extern int open_mmap_stream(struct stream *s, const char *filename);
 extern void close_stream(struct stream *s);
 
+/* returns the next character, or '\0' at the end without advancing */
 extern char stream_getc(struct stream *s);
+/* undoes the last stream_getc, which only moves back if that call read
+   a character. returns the character before the current position */
 extern char stream_ungetc(struct stream *s);
 
+/* reads the rest of the input so the whole text is in the window.
+   returns the total size of the input */
+extern size_t stream_read_all(struct stream *s);
+extern size_t stream_position(const struct stream *s);
+extern const char *stream_text(const struct stream *s, size_t pos);
+
+/* returns the unread text already in the window and sets *end to its end.
+   the window may be empty while STREAM_FILE has more to read */
+extern const char *stream_window(const struct stream *s, const char **end);
+/* consumes n bytes of the window */
+extern void stream_skip(struct stream *s, size_t n);
+
 #endif /* XXX_H */
@@ -4,164 +4,310 @@ See LICENSE and README
 */
 
 #include "symbol.h"
+#include "arena.h"
+#include "intern.h"
 #include "memory.h"
 #include <string.h>
 #include <assert.h>
 
-#define HASH_SIZE 1237 /* a prime number */
-#define MULTIPLIER 31
+/* a power of two */
+#define INITIAL_CAPACITY 1024
+/* resizes when more than MAX_LOAD_NUM/MAX_LOAD_DEN of the slots are used */
+#define MAX_LOAD_NUM 1
+#define MAX_LOAD_DEN 2
 
-struct table_entry {
-	struct symbol sym;
-	struct table_entry *next;
+/* a slot is empty when name is NULL. a name stays in its slot once added
+   and sym is its innermost visible symbol, or NULL when no scope that is
+   still open defines it. names are interned so slots compare pointers and
+   the hash comes with the name */
+struct slot {
+	const char *name;
+	struct symbol *sym;
+	int depth;
+};
+
+/* what define_symbol replaced in a slot, to restore when the scope closes */
+struct undo {
+	const char *name;
+	struct symbol *prev;
+	int prev_depth;
 };
-#define INIT_TABLE_ENTRY {INIT_SYMBOL, NULL}
 
 struct symbol_table {
-	struct table_entry *table[HASH_SIZE];
+	struct slot *slots;
+	unsigned long capacity;
+	unsigned long count;
+	/* symbols never move once added and outlive their scopes */
+	struct arena arena;
+
+	/* log of definitions in open scopes and where each scope starts in it.
+	   the file scope is depth 0 and is never closed */
+	struct undo *log;
+	int n_log;
+	int max_log;
+	int *scopes;
+	int depth;
+	int max_depth;
 };
-#define INIT_SYBOL_TABLE {{NULL}}
 
-static struct table_entry *new_entry(const char *name);
-static void free_entry(struct table_entry *entry);
-static unsigned int hash_fn(const char *key);
-static char *str_dup(const char *src);
+static struct slot *find_slot(const struct symbol_table *table,
+		const char *name);
+static struct slot *insert_slot(struct symbol_table *table,
+		const char *name);
+static int grow_table(struct symbol_table *table);
+static struct symbol *new_symbol(struct symbol_table *table,
+		const char *name, int kind);
 
 struct symbol_table *new_symbol_table(void)
 {
 	struct symbol_table *table = MEMORY_ALLOC(struct symbol_table);
-	int i;
+	const struct arena ini_arena = ARENA_INIT;
+	unsigned long i;
 
 	if (table == NULL) {
 		return NULL;
 	}
-	for (i = 0; i < HASH_SIZE; i++) {
-		table->table[i] = NULL;
+	table->slots = MEMORY_ALLOC_ARRAY(struct slot, INITIAL_CAPACITY);
+	if (table->slots == NULL) {
+		MEMORY_FREE(table);
+		return NULL;
+	}
+	for (i = 0; i < INITIAL_CAPACITY; i++) {
+		table->slots[i].name = NULL;
 	}
+	table->capacity = INITIAL_CAPACITY;
+	table->count = 0;
+	table->arena = ini_arena;
+	table->log = NULL;
+	table->n_log = 0;
+	table->max_log = 0;
+	table->scopes = NULL;
+	table->depth = 0;
+	table->max_depth = 0;
 	return table;
 }
 
 void free_symbol_table(struct symbol_table *table)
 {
-	struct table_entry *entry = NULL;
-	struct table_entry *kill = NULL;
-	int i;
-
 	if (table == NULL) {
 		return;
 	}
-	for (i = 0; i < HASH_SIZE; i++) {
-		if (table->table[i] == NULL) {
-			continue;
-		}
-		for (entry = table->table[i]; entry != NULL; ) {
-			kill = entry;
-			entry = entry->next;
-			free_entry(kill);
-		}
-	}
+	arena_free(&table->arena);
+	MEMORY_FREE(table->slots);
+	MEMORY_FREE(table->log);
+	MEMORY_FREE(table->scopes);
 	MEMORY_FREE(table);
 }
 
-struct symbol *lookup_symbol(struct symbol_table *table, const char *key)
+struct symbol *lookup_symbol(struct symbol_table *table, const char *name)
 {
-	struct table_entry *entry = NULL;
-	const int h = hash_fn(key);
-	for (entry = table->table[h]; entry != NULL; entry = entry->next) {
-		if (strcmp(key, entry->sym.name) == 0) {
-      return &entry->sym;
-		}
-	}
-	return NULL;
+	const struct slot *slot = find_slot(table, name);
+	return slot->name == NULL ? NULL : slot->sym;
 }
 
 struct symbol *add_symbol(struct symbol_table *table,
 		const char *name, int kind)
 {
-  const struct type_info ini_type = INIT_TYPE_INFO;
-	struct table_entry *entry = NULL;
-	const int h = hash_fn(name);
-
-	for (entry = table->table[h]; entry != NULL; entry = entry->next) {
-		if (strcmp(name, entry->sym.name) == 0) {
-			return &entry->sym;
-		}
-	}
-	assert(entry == NULL);
+	struct slot *slot = insert_slot(table, name);
 
-	entry = new_entry(name);
-	if (entry == NULL) {
-		/* TODO error handling */
+	if (slot == NULL) {
 		return NULL;
 	}
+	if (slot->sym != NULL) {
+		return slot->sym;
+	}
 
-	entry->sym.kind = kind;
-	entry->sym.type = ini_type;
-	entry->next = table->table[h];
-	table->table[h] = entry;
-
-	return &entry->sym;
+	/* nothing open defines it so it belongs to the file scope */
+	slot->sym = new_symbol(table, slot->name, kind);
+	slot->depth = 0;
+	return slot->sym;
 }
 
-static struct table_entry *new_entry(const char *name)
+struct symbol *define_symbol(struct symbol_table *table,
+		const char *name, int kind)
 {
-	struct table_entry *entry = MEMORY_ALLOC(struct table_entry);
+	struct slot *slot = insert_slot(table, name);
+	struct symbol *sym = NULL;
 
-	if (entry == NULL) {
+	if (slot == NULL) {
 		return NULL;
 	}
+	if (slot->sym != NULL && slot->depth == table->depth) {
+		return slot->sym;
+	}
 
-	entry->sym.name = str_dup(name);
-	if (entry->sym.name == NULL) {
-		free_entry(entry);
+	sym = new_symbol(table, slot->name, kind);
+	if (sym == NULL) {
 		return NULL;
 	}
-	entry->sym.kind = SYM_NONE;
 
-	return entry;
+	if (table->depth > 0) {
+		struct undo *u = NULL;
+
+		if (table->n_log == table->max_log) {
+			const int new_max = table->max_log == 0 ? 256 : table->max_log * 2;
+			struct undo *new_log = MEMORY_REALLOC_ARRAY(table->log, struct undo, new_max);
+
+			if (new_log == NULL) {
+				return NULL;
+			}
+			table->log = new_log;
+			table->max_log = new_max;
+		}
+		u = &table->log[table->n_log++];
+		u->name = slot->name;
+		u->prev = slot->sym;
+		u->prev_depth = slot->depth;
+	}
+
+	slot->sym = sym;
+	slot->depth = table->depth;
+	return sym;
+}
+
+int open_scope(struct symbol_table *table)
+{
+	if (table->depth == table->max_depth) {
+		const int new_max = table->max_depth == 0 ? 16 : table->max_depth * 2;
+		int *new_scopes = MEMORY_REALLOC_ARRAY(table->scopes, int, new_max);
+
+		if (new_scopes == NULL) {
+			return 0;
+		}
+		table->scopes = new_scopes;
+		table->max_depth = new_max;
+	}
+	table->scopes[table->depth++] = table->n_log;
+	return 1;
 }
 
-void free_entry(struct table_entry *entry)
+void close_scope(struct symbol_table *table)
 {
-	if (entry == NULL) {
+	int mark = 0;
+
+	if (table->depth == 0) {
 		return;
 	}
-	if (entry->sym.name != NULL) {
-		MEMORY_FREE(entry->sym.name);
+	mark = table->scopes[--table->depth];
+
+	/* undoes the definitions of the scope in reverse order */
+	while (table->n_log > mark) {
+		const struct undo *u = &table->log[--table->n_log];
+		struct slot *slot = find_slot(table, u->name);
+
+		slot->sym = u->prev;
+		slot->depth = u->prev_depth;
+	}
+}
+
+int scope_depth(const struct symbol_table *table)
+{
+	return table->depth;
+}
+
+unsigned long symbol_count(const struct symbol_table *table)
+{
+	return table->count;
+}
+
+unsigned long symbol_capacity(const struct symbol_table *table)
+{
+	return table->capacity;
+}
+
+/* returns the slot holding the name or the empty slot where it belongs */
+static struct slot *find_slot(const struct symbol_table *table,
+		const char *name)
+{
+	const unsigned long mask = table->capacity - 1;
+	unsigned long i = intern_hash(name) & mask;
+
+	for (;;) {
+		struct slot *slot = &table->slots[i];
+
+		if (slot->name == NULL || slot->name == name) {
+			return slot;
+		}
+		i = (i + 1) & mask;
 	}
-	MEMORY_FREE(entry);
 }
 
-static unsigned int hash_fn(const char *key)
+/* returns the slot of the name adding it when it is new, or NULL */
+static struct slot *insert_slot(struct symbol_table *table,
+		const char *name)
 {
-	unsigned int h = 0;
-	unsigned char *p = NULL;
+	struct slot *slot = find_slot(table, name);
 
-	for (p = (unsigned char *) key; *p != '\0'; p++) {
-		h = MULTIPLIER * h + *p;
+	if (slot->name != NULL) {
+		return slot;
 	}
 
-	return h % HASH_SIZE;
+	if ((table->count + 1) * MAX_LOAD_DEN > table->capacity * MAX_LOAD_NUM) {
+		if (!grow_table(table)) {
+			return NULL;
+		}
+		slot = find_slot(table, name);
+	}
+	assert(slot->name == NULL);
+
+	slot->name = name;
+	slot->sym = NULL;
+	slot->depth = 0;
+	table->count++;
+
+	return slot;
 }
 
-static char *str_dup(const char *src)
+static int grow_table(struct symbol_table *table)
 {
-	size_t alloc_size = 0;
-	char *dst = 0;
+	const unsigned long new_capacity = table->capacity * 2;
+	const unsigned long mask = new_capacity - 1;
+	struct slot *new_slots = MEMORY_ALLOC_ARRAY(struct slot, new_capacity);
+	unsigned long i;
 
-	if (src == NULL) {
-		return NULL;
+	if (new_slots == NULL) {
+		return 0;
+	}
+	for (i = 0; i < new_capacity; i++) {
+		new_slots[i].name = NULL;
+	}
+
+	for (i = 0; i < table->capacity; i++) {
+		const struct slot *slot = &table->slots[i];
+		unsigned long j;
+
+		if (slot->name == NULL) {
+			continue;
+		}
+		for (j = intern_hash(slot->name) & mask; new_slots[j].name != NULL;
+				j = (j + 1) & mask) {
+		}
+		new_slots[j] = *slot;
 	}
 
-	alloc_size = strlen(src) + 1;
+	MEMORY_FREE(table->slots);
+	table->slots = new_slots;
+	table->capacity = new_capacity;
+	return 1;
+}
+
+/* symbols share the interned name */
+static struct symbol *new_symbol(struct symbol_table *table,
+		const char *name, int kind)
+{
+	const struct type_info ini_type = INIT_TYPE_INFO;
+	struct symbol *sym = (struct symbol *) arena_alloc(&table->arena,
+			sizeof(struct symbol));
 
-	dst = MEMORY_ALLOC_ARRAY(char, alloc_size);
-	if (dst == NULL) {
+	if (sym == NULL) {
 		return NULL;
 	}
 
-	strncpy(dst, src, alloc_size);
-	return dst;
+	sym->name = name;
+	sym->kind = kind;
+	sym->type = ini_type;
+
+	return sym;
 }
 
 const char *symbol_name(const struct symbol *sym)
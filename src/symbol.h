@@ -19,7 +19,7 @@ enum symbol_kind {
 };
 
 struct symbol {
-	char *name;
+	const char *name;
 	int kind;
   struct type_info type;
 };
@@ -31,8 +31,31 @@ extern struct type_info symbol_type(const struct symbol *sym);
 extern struct symbol_table *new_symbol_table(void);
 extern void free_symbol_table(struct symbol_table *table);
 
-extern struct symbol *lookup_symbol(struct symbol_table *table, const char *key);
+/* names must come from intern, and symbols keep pointing at them */
+
+/* returns the innermost visible symbol by the name or NULL */
+extern struct symbol *lookup_symbol(struct symbol_table *table,
+		const char *name);
+/* returns the visible symbol by the name, adding it to the file scope
+   when there is none, or NULL on memory allocation failure */
 extern struct symbol *add_symbol(struct symbol_table *table,
 		const char *name, int kind);
+/* adds a symbol to the current scope, shadowing outer ones by the name.
+   returns the existing one if the current scope already defines it,
+   or NULL on memory allocation failure */
+extern struct symbol *define_symbol(struct symbol_table *table,
+		const char *name, int kind);
+
+/* scopes nest inside the file scope. closing a scope hides its symbols
+   again in time proportional to the number it defined. symbols stay
+   valid until free_symbol_table. open_scope returns 0 on memory
+   allocation failure without opening a scope, otherwise 1 */
+extern int open_scope(struct symbol_table *table);
+extern void close_scope(struct symbol_table *table);
+extern int scope_depth(const struct symbol_table *table);
+
+/* distinct names in the table and the slots holding them */
+extern unsigned long symbol_count(const struct symbol_table *table);
+extern unsigned long symbol_capacity(const struct symbol_table *table);
 
 #endif /* XXX_H */
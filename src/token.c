@@ -17,6 +17,16 @@ int int_value_of(const struct token *tok)
   return tok->value.Integer;
 }
 
+long long_value_of(const struct token *tok)
+{
+  return tok->value.Integer;
+}
+
+double double_value_of(const struct token *tok)
+{
+  return tok->value.Float;
+}
+
 float float_value_of(const struct token *tok)
 {
   return tok->value.Float;
@@ -24,7 +34,7 @@ float float_value_of(const struct token *tok)
 
 const char *word_value_of(const struct token *tok)
 {
-  return tok->value.word;
+  return tok->word;
 }
 
 const char *string_value_of(const struct token *tok)
@@ -32,6 +42,26 @@ const char *string_value_of(const struct token *tok)
   return tok->value.String;
 }
 
+int word_length_of(const struct token *tok)
+{
+  return tok->len;
+}
+
+int line_of(const struct token *tok)
+{
+  return tok->loc.line;
+}
+
+const struct location *location_of(const struct token *tok)
+{
+  return &tok->loc;
+}
+
+int type_of(const struct token *tok)
+{
+  return tok->type;
+}
+
 static const char *ascii2str[] = {
 "NUL", "SOH", "STX", "ETX", "EOT", "ENQ", "ACK", "BEL", "BS", "HT",
 "LF", "VT", "FF", "CR", "SO", "SI", "DLE", "DC1", "DC2", "DC3",
@@ -47,30 +77,28 @@ static const char *ascii2str[] = {
 "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
 "{", "|", "}", "~", "DEL"};
 
-static const struct tks{
-  int kind;
-  const char *str;
-} tokstr[] = {
-#define T(tag,str) {tag,str},
+/* indexed by kind - TK_BEGIN - 1 */
+static const char *const tokstr[] = {
+#define T(tag,str) str,
   TOKEN_KIND_LIST(T)
   KEYWORD_LIST(T)
 #undef T
-  {0,""} /* for no-comma entry */
 };
-static const size_t N_TOKENS = sizeof(tokstr)/sizeof(struct tks) - 1;
+
+/* fail to compile when a table gets out of sync with its kinds */
+typedef char ascii2str_covers_ascii[
+    sizeof(ascii2str)/sizeof(ascii2str[0]) == 128 ? 1 : -1];
+typedef char tokstr_covers_token_kinds[
+    sizeof(tokstr)/sizeof(tokstr[0]) == TK_END - TK_BEGIN - 1 ? 1 : -1];
 
 const char *kind_to_string(int kind)
 {
-  int i;
-
-  if (kind < 128) {
+  if (kind >= 0 && kind < 128) {
     return ascii2str[kind];
   }
 
-  for (i = 0; i < N_TOKENS; i++) {
-    if (tokstr[i].kind == kind) {
-      return tokstr[i].str;
-    }
+  if (kind > TK_BEGIN && kind < TK_END) {
+    return tokstr[kind - TK_BEGIN - 1];
   }
 
   return "";
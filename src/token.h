@@ -68,25 +68,47 @@ enum token_kind {
   TK_END
 };
 
-#define TOKEN_MAX_WORD_SIZE 128
+/* where a token or node starts in the source. line and column count from 1
+   and offset counts bytes from 0. all zero when unknown */
+struct location {
+  unsigned int offset;
+  int line;
+  int column;
+};
+
+#define LOCATION_INIT {0,0,0}
 
+/* word is a span into the source text of len characters and is not null
+   terminated. for string literals word and String are the literal with
+   escapes decoded, held in the string arena of the lexer and null
+   terminated. numbers also carry their binary value and their type */
 struct token {
   int kind;
+  int len;
+  const char *word;
   union {
     long Integer;
     double Float;
     const char *String;
-    char word[TOKEN_MAX_WORD_SIZE];
   } value;
+  /* TK_NUMBER: TYPE_INT, TYPE_LONG, TYPE_FLOAT, TYPE_DOUBLE or TYPE_CHAR */
+  int type;
+  struct location loc;
 };
 
-#define TOKEN_INIT {0,{0}}
+#define TOKEN_INIT {0,0,NULL,{0},0,LOCATION_INIT}
 
 extern int kind_of(const struct token *tok);
 extern int int_value_of(const struct token *tok);
+extern long long_value_of(const struct token *tok);
+extern double double_value_of(const struct token *tok);
 extern float float_value_of(const struct token *tok);
 extern const char *word_value_of(const struct token *tok);
 extern const char *string_value_of(const struct token *tok);
+extern int word_length_of(const struct token *tok);
+extern int line_of(const struct token *tok);
+extern const struct location *location_of(const struct token *tok);
+extern int type_of(const struct token *tok);
 
 extern const char *kind_to_string(int kind);
 
@@ -0,0 +1,130 @@
+#include "ast.h"
+#include "cgen.h"
+#include "emitter.h"
+#include "parser.h"
+#include "unit_test.h"
+#include <stdio.h>
+
+struct visit_log {
+  char text[64];
+  int len;
+  long n_visits;
+};
+
+/* logs kinds as "<k" before, "|k" between and ">k" after the subtrees */
+static void log_visit(const struct ast_node *node, enum ast_visit_order order,
+    void *data)
+{
+  struct visit_log *log = (struct visit_log *) data;
+  const char mark = order == AST_VISIT_PRE ? '<' : order == AST_VISIT_IN ? '|' : '>';
+  const char kind = node->kind == AST_ADD ? '+' : node->kind == AST_MUL ? '*' : 'l';
+
+  log->n_visits++;
+  if (log->len + 2 < (int) sizeof(log->text)) {
+    log->text[log->len++] = mark;
+    log->text[log->len++] = kind;
+    log->text[log->len] = '\0';
+  }
+}
+
+/* occurrences of word in the len characters of text */
+static int count_words(const char *text, size_t len, const char *word)
+{
+  const size_t n = strlen(word);
+  size_t i;
+  int count = 0;
+
+  for (i = 0; i + n <= len; i++) {
+    count += memcmp(text + i, word, n) == 0;
+  }
+  return count;
+}
+
+int main()
+{
+  const char filename[] = "ast_test.es";
+  enum { N_STATEMENTS = 100000 };
+  {
+    FILE *file = fopen(filename, "w");
+    int i;
+
+    fprintf(file, "fn main() int\n{\n  var x int = 0;\n");
+    for (i = 0; i < N_STATEMENTS; i++) {
+      fprintf(file, "  x = x + 1;\n");
+    }
+    fprintf(file, "  return x;\n}\n");
+    fclose(file);
+  }
+	{
+		/* (l * l) + l */
+		struct arena nodes = ARENA_INIT;
+		struct ast_node *a = new_node(&nodes, AST_LITERAL, NULL, NULL);
+		struct ast_node *b = new_node(&nodes, AST_LITERAL, NULL, NULL);
+		struct ast_node *c = new_node(&nodes, AST_LITERAL, NULL, NULL);
+		struct ast_node *mul = new_node(&nodes, AST_MUL, a, b);
+		struct ast_node *add = new_node(&nodes, AST_ADD, mul, c);
+		struct visit_log log = {{'\0'}, 0, 0};
+
+		TEST_INT(ast_walk(add, log_visit, &log), 1);
+		TEST_STR(log.text, "<+<*<l|l>l|*<l|l>l>*|+<l|l>l>+");
+		TEST_LONG(log.n_visits, 15);
+
+		/* nothing to visit */
+		log.n_visits = 0;
+		TEST_INT(ast_walk(NULL, log_visit, &log), 1);
+		TEST_LONG(log.n_visits, 0);
+
+		arena_free(&nodes);
+	}
+	{
+		/* a list spine far deeper than the walker's local stack */
+		struct arena nodes = ARENA_INIT;
+		struct ast_node *list = NULL;
+		struct visit_log log = {{'\0'}, 0, 0};
+		int i;
+
+		for (i = 0; i < 300000; i++) {
+			struct ast_node *item = new_node(&nodes, AST_LITERAL, NULL, NULL);
+			list = new_node(&nodes, AST_LIST, list, item);
+		}
+		TEST_INT(ast_walk(list, log_visit, &log), 1);
+		TEST_LONG(log.n_visits, 3L * 600000);
+
+		arena_free(&nodes);
+	}
+	{
+		/* generates code for a long function without deep recursion */
+		struct symbol_table *symtbl = new_symbol_table();
+		struct interner *names = new_interner();
+		struct constant_pool *consts = new_constant_pool();
+		struct arena nodes = ARENA_INIT;
+		struct parser p = PARSER_INIT;
+		struct emitter code = EMITTER_INIT;
+		struct ast_node *node = NULL;
+		struct context cxt = INIT_CONTEXT;
+
+		cxt.consts = consts;
+		p.symtbl = symtbl;
+		p.names = names;
+		p.consts = consts;
+		p.nodes = &nodes;
+		node = parse_file(&p, filename);
+		TEST(node != NULL);
+
+		TEST_INT(emit_c_code(&code, node, &cxt), 1);
+		TEST_INT(count_words(code.buf, code.len, "(x = (x + 1));"), N_STATEMENTS);
+		TEST_INT(count_words(code.buf, code.len, "return x;"), 1);
+
+		free_emitter(&code);
+		parse_finish(&p);
+		arena_free(&nodes);
+		free_constant_pool(consts);
+		free_interner(names);
+		free_symbol_table(symtbl);
+	}
+
+	printf("%s: %d/%d/%d: (FAIL/PASS/TOTAL)\n", __FILE__,
+		TestGetFailCount(), TestGetPassCount(), TestGetTotalCount());
+
+	return 0;
+}
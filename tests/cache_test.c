@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "cache.h"
+#include "unit_test.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+static const char cache_dir[] = "cache_test.d";
+
+/* writes size bytes to <cache_dir>/<name> last modified at mtime */
+static void make_entry(const char *name, int size, long mtime)
+{
+  char path[256];
+  struct utimbuf times;
+  FILE *fp = NULL;
+  int i;
+
+  sprintf(path, "%s/%s", cache_dir, name);
+  fp = fopen(path, "wb");
+  for (i = 0; i < size; i++) {
+    fputc('x', fp);
+  }
+  fclose(fp);
+  times.actime = mtime;
+  times.modtime = mtime;
+  utime(path, &times);
+}
+
+static int has_entry(const char *name)
+{
+  char path[256];
+  struct stat st;
+
+  sprintf(path, "%s/%s", cache_dir, name);
+  return stat(path, &st) == 0;
+}
+
+static void remove_entry(const char *name)
+{
+  char path[256];
+
+  sprintf(path, "%s/%s", cache_dir, name);
+  remove(path);
+}
+
+int main()
+{
+	{
+		/* 64-bit FNV-1a test vectors */
+		char str[CACHE_KEY_SIZE];
+
+		TEST(cache_hash(CACHE_KEY_INIT, "", 0) == CACHE_KEY_INIT);
+		cache_key_string(cache_hash(CACHE_KEY_INIT, "", 0), str);
+		TEST_STR(str, "cbf29ce484222325");
+		cache_key_string(cache_hash(CACHE_KEY_INIT, "a", 1), str);
+		TEST_STR(str, "af63dc4c8601ec8c");
+		cache_key_string(cache_hash(CACHE_KEY_INIT, "foobar", 6), str);
+		TEST_STR(str, "85944171f73967e8");
+
+		/* hashing in pieces is hashing the whole */
+		TEST(cache_hash(cache_hash(CACHE_KEY_INIT, "foo", 3), "bar", 3) ==
+			cache_hash(CACHE_KEY_INIT, "foobar", 6));
+
+		/* strings are hashed with their null characters */
+		TEST(cache_hash_string(CACHE_KEY_INIT, "a") ==
+			cache_hash(CACHE_KEY_INIT, "a", 2));
+		TEST(cache_hash_string(cache_hash_string(CACHE_KEY_INIT, "ab"), "c") !=
+			cache_hash_string(cache_hash_string(CACHE_KEY_INIT, "a"), "bc"));
+	}
+	{
+		/* 16 hex digits with leading zeros */
+		char str[CACHE_KEY_SIZE + 1];
+
+		str[CACHE_KEY_SIZE] = '#';
+		cache_key_string(0, str);
+		TEST_STR(str, "0000000000000000");
+		TEST_INT(str[CACHE_KEY_SIZE], '#');
+
+		cache_key_string(0x1aUL, str);
+		TEST_STR(str, "000000000000001a");
+		cache_key_string(0xfedcba9876543210UL, str);
+		TEST_STR(str, "fedcba9876543210");
+		TEST_INT((int) strlen(str), CACHE_KEY_SIZE - 1);
+	}
+	{
+		/* removes the oldest entries until the cache fits */
+		struct cache cache = CACHE_INIT;
+
+		TEST_INT(open_cache(&cache, cache_dir, 250), 1);
+		make_entry("0000000000000001.o", 60, 1000);
+		make_entry("0000000000000001.c", 40, 1000);
+		make_entry("0000000000000002.o", 60, 2000);
+		make_entry("0000000000000002.c", 40, 2000);
+		make_entry("0000000000000003.o", 60, 3000);
+		make_entry("0000000000000003.c", 40, 3000);
+		make_entry("0000000000000004.o", 60, 4000);
+		make_entry("0000000000000004.c", 40, 4000);
+		/* being written by another build */
+		make_entry("0000000000000005.o.1.tmp", 100, 500);
+
+		cache_evict(&cache);
+		TEST_INT(has_entry("0000000000000001.o"), 0);
+		TEST_INT(has_entry("0000000000000001.c"), 0);
+		TEST_INT(has_entry("0000000000000002.o"), 0);
+		TEST_INT(has_entry("0000000000000002.c"), 0);
+		TEST_INT(has_entry("0000000000000003.o"), 1);
+		TEST_INT(has_entry("0000000000000003.c"), 1);
+		TEST_INT(has_entry("0000000000000004.o"), 1);
+		TEST_INT(has_entry("0000000000000004.c"), 1);
+		TEST_INT(has_entry("0000000000000005.o.1.tmp"), 1);
+
+		/* nothing to do within the limit */
+		cache_evict(&cache);
+		TEST_INT(has_entry("0000000000000003.o"), 1);
+		TEST_INT(has_entry("0000000000000004.o"), 1);
+
+		remove_entry("0000000000000003.o");
+		remove_entry("0000000000000003.c");
+		remove_entry("0000000000000004.o");
+		remove_entry("0000000000000004.c");
+		remove_entry("0000000000000005.o.1.tmp");
+		close_cache(&cache);
+		TEST(cache.dir == NULL);
+	}
+	{
+		/* a hit makes an entry the most recently used */
+		struct cache cache = CACHE_INIT;
+
+		TEST_INT(open_cache(&cache, cache_dir, 200), 1);
+		make_entry("00000000000000a1.o", 50, 1000);
+		make_entry("00000000000000a1.c", 50, 1000);
+		make_entry("00000000000000b2.o", 50, 2000);
+		make_entry("00000000000000b2.c", 50, 2500);
+		make_entry("00000000000000c3.o", 50, 3000);
+
+		TEST_INT(cache_lookup(&cache, "00000000000000a1"), 1);
+		/* both files of an entry are needed */
+		TEST_INT(cache_lookup(&cache, "00000000000000c3"), 0);
+		TEST_INT(cache_lookup(&cache, "00000000000000d4"), 0);
+
+		/* the files of an entry are removed together */
+		cache_evict(&cache);
+		TEST_INT(has_entry("00000000000000a1.o"), 1);
+		TEST_INT(has_entry("00000000000000a1.c"), 1);
+		TEST_INT(has_entry("00000000000000b2.o"), 0);
+		TEST_INT(has_entry("00000000000000b2.c"), 0);
+		TEST_INT(has_entry("00000000000000c3.o"), 1);
+
+		remove_entry("00000000000000a1.o");
+		remove_entry("00000000000000a1.c");
+		remove_entry("00000000000000c3.o");
+		close_cache(&cache);
+	}
+	{
+		/* files other than entries survive eviction */
+		struct cache cache = CACHE_INIT;
+
+		TEST_INT(open_cache(&cache, cache_dir, 0), 1);
+		make_entry("0000000000000001.o", 10, 1000);
+		make_entry("0000000000000001.c", 10, 1000);
+		make_entry("notes.txt", 10, 500);
+		make_entry("main.es", 10, 500);
+		make_entry("0123456789ABCDEF.o", 10, 500);
+		make_entry("000000000000001.o", 10, 500);
+		make_entry("0000000000000002.so", 10, 500);
+
+		cache_evict(&cache);
+		TEST_INT(has_entry("0000000000000001.o"), 0);
+		TEST_INT(has_entry("0000000000000001.c"), 0);
+		TEST_INT(has_entry("notes.txt"), 1);
+		TEST_INT(has_entry("main.es"), 1);
+		TEST_INT(has_entry("0123456789ABCDEF.o"), 1);
+		TEST_INT(has_entry("000000000000001.o"), 1);
+		TEST_INT(has_entry("0000000000000002.so"), 1);
+
+		remove_entry("notes.txt");
+		remove_entry("main.es");
+		remove_entry("0123456789ABCDEF.o");
+		remove_entry("000000000000001.o");
+		remove_entry("0000000000000002.so");
+		close_cache(&cache);
+		rmdir(cache_dir);
+	}
+
+	printf("%s: %d/%d/%d: (FAIL/PASS/TOTAL)\n", __FILE__,
+		TestGetFailCount(), TestGetPassCount(), TestGetTotalCount());
+
+	return 0;
+}
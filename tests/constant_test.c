@@ -0,0 +1,146 @@
+#include "constant.h"
+#include "intern.h"
+#include "parser.h"
+#include "type.h"
+#include "unit_test.h"
+#include <stdio.h>
+
+int main()
+{
+	const char filename[] = "constant_test.es";
+	{
+		FILE *file = fopen(filename, "w");
+		const char src[] =
+			"fn main() int\n"
+			"{\n"
+			"  var foo int = 7;\n"
+			"  var bar int = 7 + 8;\n"
+			"  print(\"hi\\n\");\n"
+			"  print(\"hi\\n\");\n"
+			"  return 0;\n"
+			"}\n";
+		fprintf(file, "%s", src);
+		fclose(file);
+	}
+	{
+		struct interner *names = new_interner();
+		struct constant_pool *pool = new_constant_pool();
+		const char *seven = intern(names, "7", 1);
+		const char *nul = intern(names, "a\0b", 3);
+		const struct constant *a = NULL;
+		const struct constant *b = NULL;
+		struct constant c;
+
+		c.id = 99;
+		c.kind = TYPE_INT;
+		c.spelling = seven;
+		c.length = 1;
+		c.value.Integer = 7;
+		a = add_constant(pool, &c);
+		TEST(a != NULL);
+		/* ids come from the pool */
+		TEST_INT(a->id, 0);
+		TEST_LONG(a->value.Integer, 7);
+
+		/* equal by spelling and kind */
+		TEST(add_constant(pool, &c) == a);
+		c.kind = TYPE_LONG;
+		b = add_constant(pool, &c);
+		TEST(b != NULL && b != a);
+		TEST_INT(b->id, 1);
+
+		/* strings keep their length past null characters */
+		c.kind = TYPE_STRING;
+		c.spelling = nul;
+		c.length = 3;
+		c.value.Integer = 0;
+		b = add_constant(pool, &c);
+		TEST_INT(b->length, 3);
+		TEST_INT(memcmp(b->spelling, "a\0b", 3), 0);
+
+		TEST_INT(constant_count(pool), 3);
+		TEST(constant_at(pool, 0) == a);
+		TEST(constant_at(pool, 2) == b);
+
+		free_constant_pool(pool);
+		free_interner(names);
+	}
+	{
+		/* more constants than the initial slots */
+		struct interner *names = new_interner();
+		struct constant_pool *pool = new_constant_pool();
+		enum { N_CONSTANTS = 5000 };
+		char buf[32];
+		int in_order = 0;
+		int found = 0;
+		int i;
+
+		for (i = 0; i < N_CONSTANTS; i++) {
+			struct constant c;
+			sprintf(buf, "%d", i);
+			c.kind = TYPE_INT;
+			c.spelling = intern(names, buf, strlen(buf));
+			c.length = strlen(buf);
+			c.value.Integer = i;
+			add_constant(pool, &c);
+		}
+		TEST_INT(constant_count(pool), N_CONSTANTS);
+
+		for (i = 0; i < N_CONSTANTS; i++) {
+			struct constant c;
+			sprintf(buf, "%d", i);
+			c.kind = TYPE_INT;
+			c.spelling = intern(names, buf, strlen(buf));
+			c.length = strlen(buf);
+			c.value.Integer = i;
+			in_order += constant_at(pool, i)->id == i;
+			found += add_constant(pool, &c) == constant_at(pool, i);
+		}
+		TEST_INT(in_order, N_CONSTANTS);
+		TEST_INT(found, N_CONSTANTS);
+		TEST_INT(constant_count(pool), N_CONSTANTS);
+
+		free_constant_pool(pool);
+		free_interner(names);
+	}
+	{
+		/* the parser puts literals in the pool and not in the symbol table */
+		struct symbol_table *symtbl = new_symbol_table();
+		struct interner *names = new_interner();
+		struct constant_pool *consts = new_constant_pool();
+		struct arena nodes = ARENA_INIT;
+		struct parser p = PARSER_INIT;
+		int n_strings = 0;
+		int i;
+
+		p.symtbl = symtbl;
+		p.names = names;
+		p.consts = consts;
+		p.nodes = &nodes;
+		TEST(parse_file(&p, filename) != NULL);
+
+		/* 7, 8, "hi\n" and 0 */
+		TEST_INT(constant_count(consts), 4);
+		for (i = 0; i < constant_count(consts); i++) {
+			n_strings += constant_at(consts, i)->kind == TYPE_STRING;
+		}
+		TEST_INT(n_strings, 1);
+
+		TEST(lookup_symbol(symtbl, intern(names, "7", 1)) == NULL);
+		TEST(lookup_symbol(symtbl, intern(names, "hi\n", 3)) == NULL);
+		/* locals are gone with their scope but main stays */
+		TEST(lookup_symbol(symtbl, intern(names, "foo", 3)) == NULL);
+		TEST(lookup_symbol(symtbl, intern(names, "main", 4)) != NULL);
+
+		parse_finish(&p);
+		arena_free(&nodes);
+		free_constant_pool(consts);
+		free_interner(names);
+		free_symbol_table(symtbl);
+	}
+
+	printf("%s: %d/%d/%d: (FAIL/PASS/TOTAL)\n", __FILE__,
+		TestGetFailCount(), TestGetPassCount(), TestGetTotalCount());
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "emitter.h"
+#include "unit_test.h"
+#include <limits.h>
+#include <stdio.h>
+
+/* the emitted text as a string */
+static const char *text_of(const struct emitter *e)
+{
+  static char buf[256];
+  const size_t len = e->len < sizeof(buf) - 1 ? e->len : sizeof(buf) - 1;
+
+  memcpy(buf, e->buf, len);
+  buf[len] = '\0';
+  return buf;
+}
+
+int main()
+{
+	{
+		struct emitter e = EMITTER_INIT;
+		char expected[64];
+
+		emit_long(&e, 0);
+		TEST_STR(text_of(&e), "0");
+
+		e.len = 0;
+		emit_long(&e, -1);
+		emit_char(&e, ' ');
+		emit_long(&e, 1234567890L);
+		TEST_STR(text_of(&e), "-1 1234567890");
+
+		/* negating LONG_MIN in long would overflow */
+		e.len = 0;
+		emit_long(&e, LONG_MIN);
+		sprintf(expected, "%ld", LONG_MIN);
+		TEST_STR(text_of(&e), expected);
+
+		e.len = 0;
+		emit_ulong(&e, ULONG_MAX);
+		sprintf(expected, "%lu", ULONG_MAX);
+		TEST_STR(text_of(&e), expected);
+
+		e.len = 0;
+		EMIT_LITERAL(&e, "static ");
+		emit_str(&e, "int");
+		emit_chars(&e, " x;??", 3);
+		TEST_STR(text_of(&e), "static int x;");
+
+		free_emitter(&e);
+		TEST(e.buf == NULL);
+		TEST_INT((int) e.len, 0);
+	}
+	{
+		/* two spaces per level, past the 32 levels copied at once */
+		struct emitter e = EMITTER_INIT;
+		size_t spaces = 0;
+		size_t i;
+
+		emit_indent(&e, 40);
+		TEST_INT((int) e.len, 80);
+		for (i = 0; i < e.len; i++) {
+			spaces += e.buf[i] == ' ';
+		}
+		TEST_INT((int) spaces, 80);
+
+		e.len = 0;
+		emit_indent(&e, 32);
+		TEST_INT((int) e.len, 64);
+
+		e.len = 0;
+		emit_indent(&e, 0);
+		emit_indent(&e, -1);
+		TEST_INT((int) e.len, 0);
+
+		free_emitter(&e);
+	}
+	{
+		/* grows across the initial capacity without losing text */
+		struct emitter e = EMITTER_INIT;
+		enum { N = 200000 };
+		size_t in_place = 0;
+		size_t i;
+
+		for (i = 0; i < N; i++) {
+			emit_char(&e, 'a' + i % 26);
+		}
+		emit_str(&e, "end");
+		TEST_INT((int) e.len, N + 3);
+		TEST(e.cap >= e.len);
+		TEST_INT(e.failed, 0);
+		for (i = 0; i < N; i++) {
+			in_place += e.buf[i] == 'a' + (char) (i % 26);
+		}
+		TEST_INT((int) in_place, N);
+		TEST_INT(memcmp(e.buf + N, "end", 3), 0);
+
+		free_emitter(&e);
+	}
+	{
+		FILE *fp = tmpfile();
+		struct emitter e = EMITTER_INIT;
+		char buf[16] = {'\0'};
+
+		EMIT_LITERAL(&e, "int main;\n");
+		TEST_INT(emitter_flush(&e, fp), 1);
+		TEST_INT((int) e.len, 0);
+		rewind(fp);
+		TEST(fgets(buf, sizeof(buf), fp) != NULL);
+		TEST_STR(buf, "int main;\n");
+
+		fclose(fp);
+		free_emitter(&e);
+	}
+	{
+		/* a request that cannot be met sets failed and later appends stop */
+		FILE *fp = tmpfile();
+		struct emitter e = EMITTER_INIT;
+
+		EMIT_LITERAL(&e, "kept");
+		emit_chars(&e, "x", (size_t) -1 / 2);
+		TEST_INT(e.failed, 1);
+		TEST_INT((int) e.len, 4);
+
+		emit_str(&e, "dropped");
+		emit_char(&e, '!');
+		emit_long(&e, 42);
+		TEST_INT((int) e.len, 4);
+
+		/* flushing a failed emitter writes nothing and reports it */
+		TEST_INT(emitter_flush(&e, fp), 0);
+		TEST_INT((int) e.len, 0);
+		TEST_LONG(ftell(fp), 0);
+		EMIT_LITERAL(&e, "x");
+		TEST_INT((int) e.len, 0);
+
+		fclose(fp);
+		free_emitter(&e);
+		TEST_INT(e.failed, 0);
+	}
+
+	printf("%s: %d/%d/%d: (FAIL/PASS/TOTAL)\n", __FILE__,
+		TestGetFailCount(), TestGetPassCount(), TestGetTotalCount());
+
+	return 0;
+}
@@ -1,6 +1,19 @@
 #include "lexer.h"
+#include "type.h"
 #include "unit_test.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+/* token words are spans into the source, copy one out to compare */
+static const char *word_of(const struct token *tok)
+{
+  static char buf[1024];
+  const int len = word_length_of(tok);
+
+  memcpy(buf, word_value_of(tok), len);
+  buf[len] = '\0';
+  return buf;
+}
 
 int main()
 {
@@ -51,36 +64,36 @@ int main()
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), "123");
+		TEST_STR(word_of(tok), "123");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), ".23");
+		TEST_STR(word_of(tok), ".23");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), "1.2312e+3");
+		TEST_STR(word_of(tok), "1.2312e+3");
 
 		TEST_INT(lex_get_line_num(&l), 2);
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), "23.23f");
+		TEST_STR(word_of(tok), "23.23f");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), "82.");
+		TEST_STR(word_of(tok), "82.");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), ".31E+4");
+		TEST_STR(word_of(tok), ".31E+4");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), '-');
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_NUMBER);
-		TEST_STR(word_value_of(tok), "23.4f");
+		TEST_STR(word_of(tok), "23.4f");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), '+');
@@ -168,11 +181,460 @@ int main()
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_IDENTIFIER);
-		TEST_STR(word_value_of(tok), "hoge");
+		TEST_STR(word_of(tok), "hoge");
 
 		tok = lex_get_token(&l);
 		TEST_INT(kind_of(tok), TK_INT);
 
+		lex_finish(&l);
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+		char src[512] = {'\0'};
+		char name[300] = {'\0'};
+
+		/* identifiers longer than the old 128-byte word buffer */
+		memset(name, 'x', sizeof(name) - 1);
+		sprintf(src, "var %s \"a string literal\" 'c' 42", name);
+
+		lex_input_string(&l, src);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_VAR);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+		TEST_INT(word_length_of(tok), 299);
+		TEST_STR(word_of(tok), name);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_STRING_LITERAL);
+		TEST_STR(word_of(tok), "a string literal");
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_NUMBER);
+		TEST_STR(word_of(tok), "c");
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_NUMBER);
+		TEST_STR(word_of(tok), "42");
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_EOS);
+
+		lex_finish(&l);
+	}
+	{
+		static const struct {
+			int kind;
+			const char *word;
+		} words[] = {
+#define T(tag,str) {tag, str},
+			KEYWORD_LIST(T)
+#undef T
+			/* near misses must stay identifiers */
+			{TK_IDENTIFIER, "boo"},
+			{TK_IDENTIFIER, "bools"},
+			{TK_IDENTIFIER, "f"},
+			{TK_IDENTIFIER, "fm"},
+			{TK_IDENTIFIER, "vardumps"},
+			{TK_IDENTIFIER, "Int"},
+			{TK_IDENTIFIER, "lonG"},
+			{TK_IDENTIFIER, "swatch"}
+		};
+		const int N = sizeof(words)/sizeof(words[0]);
+		int i;
+
+		for (i = 0; i < N; i++) {
+			struct lexer l = LEXER_INIT;
+			const struct token *tok;
+
+			lex_input_string(&l, words[i].word);
+			tok = lex_get_token(&l);
+			TEST_INT(kind_of(tok), words[i].kind);
+			TEST_STR(word_of(tok), words[i].word);
+			lex_finish(&l);
+		}
+	}
+	{
+		/* operators that end the input without a newline */
+		const char ops[] = "+-*/<>=!&|'";
+		int i;
+
+		for (i = 0; ops[i] != '\0'; i++) {
+			struct lexer l = LEXER_INIT;
+			char src[8];
+
+			sprintf(src, "a %c", ops[i]);
+			lex_input_string(&l, src);
+			TEST_INT(lex_tokenize(&l), 3);
+			TEST_INT(kind_of(&l.tokens[1]), ops[i]);
+			TEST_INT(kind_of(&l.tokens[2]), TK_EOS);
+			lex_finish(&l);
+		}
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+
+		lex_input_string(&l, "fn main() int\n{\n  return 0;\n}\n");
+		TEST_INT(lex_tokenize(&l), 11);
+
+		/* arbitrary lookahead without consuming */
+		tok = lex_peek_token(&l, 1);
+		TEST_INT(kind_of(tok), TK_FN);
+		tok = lex_peek_token(&l, 7);
+		TEST_INT(kind_of(tok), TK_RETURN);
+		TEST_INT(line_of(tok), 3);
+		tok = lex_peek_token(&l, 100);
+		TEST_INT(kind_of(tok), TK_EOS);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_FN);
+		TEST_INT(lex_get_line_num(&l), 1);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+		TEST_STR(word_of(tok), "main");
+
+		tok = lex_unget_token(&l);
+		TEST_INT(kind_of(tok), TK_FN);
+		tok = lex_unget_token(&l);
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_FN);
+
+		while (kind_of(tok) != '}') {
+			tok = lex_get_token(&l);
+		}
+		TEST_INT(lex_get_line_num(&l), 4);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_EOS);
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_EOS);
+
+		lex_finish(&l);
+	}
+	{
+		const char unit[] =
+			"fn f() int { var s string = \"a // b\n/* c */\"; }\n"
+			"/* '\"' \n ** // **/ var c char = '\"';\n"
+			"  // \" not a string \n"
+			"var x int = 0x12 + 3.4e+2 - '/'; /*\n*/ x++;\n";
+		const int N_UNITS = 500;
+		struct lexer serial = LEXER_INIT;
+		struct lexer parallel = LEXER_INIT;
+		char *src = malloc(sizeof(unit) * N_UNITS);
+		int n_serial, n_parallel;
+		int n_mismatch = 0;
+		int i;
+
+		src[0] = '\0';
+		for (i = 0; i < N_UNITS; i++) {
+			strcat(src, unit);
+		}
+
+		lex_input_string(&serial, src);
+		lex_input_string(&parallel, src);
+		n_serial = lex_tokenize_parallel(&serial, 1, 1);
+		n_parallel = lex_tokenize_parallel(&parallel, 37, 4);
+		TEST_INT(n_parallel, n_serial);
+
+		for (i = 0; i < n_serial && i < n_parallel; i++) {
+			const struct token *a = &serial.tokens[i];
+			const struct token *b = &parallel.tokens[i];
+			if (a->kind != b->kind || a->len != b->len ||
+					a->loc.line != b->loc.line || a->loc.column != b->loc.column ||
+					a->loc.offset != b->loc.offset ||
+					(a->kind != TK_EOS &&
+					strncmp(word_value_of(a), word_value_of(b), a->len) != 0)) {
+				n_mismatch++;
+			}
+		}
+		TEST_INT(n_mismatch, 0);
+		TEST_INT(lex_get_line_num(&parallel), lex_get_line_num(&serial));
+		TEST_INT(kind_of(&parallel.tokens[n_parallel - 1]), TK_EOS);
+
+		lex_finish(&serial);
+		lex_finish(&parallel);
+		free(src);
+	}
+	{
+		/* stray quotes in invalid input split the same as they lex */
+		const char unit[] =
+			"var a int = '\"; b = 1;\n"
+			"x = '\n+ 1; c = ''';\n"
+			"d = 'ab'; e = '';\n";
+		const int N_UNITS = 300;
+		struct lexer serial = LEXER_INIT;
+		struct lexer parallel = LEXER_INIT;
+		char *src = malloc(sizeof(unit) * N_UNITS);
+		int n_serial, n_parallel;
+		int n_mismatch = 0;
+		int i;
+
+		src[0] = '\0';
+		for (i = 0; i < N_UNITS; i++) {
+			strcat(src, unit);
+		}
+
+		lex_input_string(&serial, src);
+		lex_input_string(&parallel, src);
+		n_serial = lex_tokenize_parallel(&serial, 1, 1);
+		n_parallel = lex_tokenize_parallel(&parallel, 29, 4);
+		TEST_INT(n_parallel, n_serial);
+
+		for (i = 0; i < n_serial && i < n_parallel; i++) {
+			const struct token *a = &serial.tokens[i];
+			const struct token *b = &parallel.tokens[i];
+			if (a->kind != b->kind || a->len != b->len ||
+					a->loc.line != b->loc.line || a->loc.column != b->loc.column ||
+					a->loc.offset != b->loc.offset) {
+				n_mismatch++;
+			}
+		}
+		TEST_INT(n_mismatch, 0);
+		TEST_INT(lex_get_line_num(&parallel), lex_get_line_num(&serial));
+
+		lex_finish(&serial);
+		lex_finish(&parallel);
+		free(src);
+	}
+	{
+		/* the newline after a stray quote still counts */
+		struct lexer l = LEXER_INIT;
+
+		lex_input_string(&l, "'\nx");
+		TEST_INT(lex_tokenize(&l), 3);
+		TEST_INT(kind_of(&l.tokens[0]), '\'');
+		TEST_INT(line_of(&l.tokens[0]), 1);
+		TEST_INT(kind_of(&l.tokens[1]), TK_IDENTIFIER);
+		TEST_INT(line_of(&l.tokens[1]), 2);
+		lex_finish(&l);
+	}
+	{
+		struct interner *names = new_interner();
+		struct lexer serial = LEXER_INIT;
+		struct lexer parallel = LEXER_INIT;
+		const char src[] =
+			"var count int = 10;\nfn f() int { count = count + 10; }\n"
+			"var s string = \"count\";\n";
+		int n_serial, n_parallel;
+		int i;
+
+		lex_input_string(&serial, src);
+		lex_input_string(&parallel, src);
+		serial.names = names;
+		parallel.names = names;
+		n_serial = lex_tokenize(&serial);
+		n_parallel = lex_tokenize_parallel(&parallel, 3, 2);
+		TEST_INT(n_parallel, n_serial);
+
+		/* same spellings share one pointer across tokens and lexers */
+		TEST_INT(serial.tokens[1].word == serial.tokens[12].word, 1);
+		TEST_INT(serial.tokens[1].word == serial.tokens[14].word, 1);
+		TEST_INT(serial.tokens[4].word == serial.tokens[16].word, 1);
+		TEST_INT(serial.tokens[1].word == serial.tokens[23].word, 1);
+		TEST_STR(string_value_of(&serial.tokens[23]), "count");
+		TEST_INT(intern_length(serial.tokens[1].word), 5);
+		TEST_INT(intern(names, "count", 5) == serial.tokens[1].word, 1);
+
+		/* keywords and operators are still spans into each input */
+		for (i = 0; i < n_serial && i < n_parallel; i++) {
+			const int kind = kind_of(&serial.tokens[i]);
+			if ((kind == TK_IDENTIFIER || kind == TK_NUMBER ||
+					kind == TK_STRING_LITERAL) &&
+					serial.tokens[i].word != parallel.tokens[i].word) {
+				break;
+			}
+		}
+		TEST_INT(i, n_serial);
+
+		lex_finish(&serial);
+		lex_finish(&parallel);
+		free_interner(names);
+	}
+	{
+		TEST_STR(kind_to_string('('), "(");
+		TEST_STR(kind_to_string(TK_INC), "++");
+		TEST_STR(kind_to_string(TK_EOS), "EOS");
+		TEST_STR(kind_to_string(TK_BOOL), "bool");
+		TEST_STR(kind_to_string(TK_VARDUMP), "vardump");
+		TEST_STR(kind_to_string(TK_END), "");
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+
+		lex_input_string(&l, "123 0x1fF 3.14 .5e+2 2.5f 42L 4294967296 'c'");
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_INT);
+		TEST_LONG(long_value_of(tok), 123);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_INT);
+		TEST_LONG(long_value_of(tok), 0x1fF);
+		TEST_STR(word_of(tok), "0x1fF");
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_DOUBLE);
+		TEST_DOUBLE(double_value_of(tok), 3.14);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_DOUBLE);
+		TEST_DOUBLE(double_value_of(tok), .5e+2);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_FLOAT);
+		TEST_DOUBLE(double_value_of(tok), 2.5);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_LONG);
+		TEST_LONG(long_value_of(tok), 42);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_LONG);
+		TEST_DOUBLE(long_value_of(tok), 4294967296.);
+
+		tok = lex_get_token(&l);
+		TEST_INT(type_of(tok), TYPE_CHAR);
+		TEST_LONG(long_value_of(tok), 'c');
+
+		lex_finish(&l);
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+		const struct token *first;
+		char *src = malloc(4096);
+		char *text = malloc(4096);
+
+		/* literals longer than the old 1024-byte string buffer */
+		memset(text, 's', 3000);
+		text[3000] = '\0';
+		sprintf(src, "\"tab\\t \\\"quoted\\\" back\\\\slash\\n\" \"%s\" x", text);
+
+		lex_input_string(&l, src);
+		TEST_INT(lex_tokenize(&l), 4);
+
+		first = lex_get_token(&l);
+		TEST_INT(kind_of(first), TK_STRING_LITERAL);
+		TEST_STR(string_value_of(first), "tab\t \"quoted\" back\\slash\n");
+		TEST_INT(word_length_of(first), 25);
+
+		/* the first literal survives the second */
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_STRING_LITERAL);
+		TEST_INT(word_length_of(tok), 3000);
+		TEST_STR(string_value_of(tok), text);
+		TEST_STR(string_value_of(first), "tab\t \"quoted\" back\\slash\n");
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+
+		lex_finish(&l);
+		free(src);
+		free(text);
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+
+		/* runs longer than one 16 byte block and ending inside one */
+		lex_input_string(&l,
+			"   \t\t                        \v  first_identifier_of_forty_bytes_\n"
+			"// a line comment longer than a single block of sixteen bytes\n"
+			"/* a block comment ** with stars * and\n"
+			"   newlines\n"
+			"   spanning several blocks ***/ second /**/third\n"
+			"/* unclosed comment ending in a star *");
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+		TEST_STR(word_of(tok), "first_identifier_of_forty_bytes_");
+		TEST_INT(line_of(tok), 1);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+		TEST_STR(word_of(tok), "second");
+		TEST_INT(line_of(tok), 5);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_IDENTIFIER);
+		TEST_STR(word_of(tok), "third");
+		TEST_INT(line_of(tok), 5);
+
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), 0);
+		TEST_INT(lex_get_line_num(&l), 6);
+
+		lex_finish(&l);
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+		const char src[] =
+			"fn f() int\n"
+			"{\n"
+			"\t/* a\n   b */ x = 12;\n"
+			"}";
+
+		lex_input_string(&l, src);
+		TEST_INT(lex_tokenize(&l), 12);
+
+		tok = lex_get_token(&l);
+		TEST_INT(location_of(tok)->line, 1);
+		TEST_INT(location_of(tok)->column, 1);
+		TEST_INT(location_of(tok)->offset, 0);
+
+		tok = lex_get_token(&l);
+		TEST_STR(word_of(tok), "f");
+		TEST_INT(location_of(tok)->column, 4);
+		TEST_INT(location_of(tok)->offset, 3);
+
+		while (kind_of(tok) != TK_IDENTIFIER || word_of(tok)[0] != 'x') {
+			tok = lex_get_token(&l);
+		}
+		TEST_INT(location_of(tok)->line, 4);
+		TEST_INT(location_of(tok)->column, 9);
+		TEST_INT(location_of(tok)->offset, (int) (strstr(src, "x =") - src));
+		TEST_INT(lex_get_column_num(&l), 9);
+
+		tok = lex_get_token(&l);
+		tok = lex_get_token(&l);
+		TEST_STR(word_of(tok), "12");
+		TEST_INT(location_of(tok)->column, 13);
+		TEST_INT(location_of(tok)->offset, (int) (strstr(src, "12") - src));
+
+		lex_finish(&l);
+	}
+	{
+		struct lexer l = LEXER_INIT;
+		const struct token *tok;
+
+		lex_input_string(&l,
+		    "\"A\\x41B\\x4a\\xg\" \"\\012C\\101\\1234\\7\" \"x\\0y\\n\"");
+
+		/* hex takes up to two digits and \x without one is an x */
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_STRING_LITERAL);
+		TEST_INT(word_length_of(tok), 6);
+		TEST_INT(memcmp(string_value_of(tok), "AABJxg", 6), 0);
+
+		/* octal takes one to three digits */
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_STRING_LITERAL);
+		TEST_INT(word_length_of(tok), 6);
+		TEST_INT(memcmp(string_value_of(tok), "\nCAS4\a", 6), 0);
+
+		/* a null character does not end the literal */
+		tok = lex_get_token(&l);
+		TEST_INT(kind_of(tok), TK_STRING_LITERAL);
+		TEST_INT(word_length_of(tok), 4);
+		TEST_INT(memcmp(string_value_of(tok), "x\0y\n", 4), 0);
+
 		lex_finish(&l);
 	}
 #if 0
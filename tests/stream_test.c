@@ -1,16 +1,27 @@
 #include "stream.h"
 #include "unit_test.h"
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 int main()
 {
   const char filename[] = "stream_test.es";
+  const char bigfile[] = "stream_test_big.es";
   {
     FILE *file = fopen(filename, "w");
     const char src[] = "this\nis\ntest\n";
     fprintf(file, "%s", src);
     fclose(file);
   }
+  {
+    FILE *file = fopen(bigfile, "w");
+    int i;
+    for (i = 0; i < STREAM_CHUNK_SIZE + 100; i++) {
+      fputc('a' + i % 26, file);
+    }
+    fclose(file);
+  }
 
   {
     const char src[] = " abcd 12.3 /* ... */  \n this is stream?";
@@ -134,6 +145,81 @@ int main()
 
     close_stream(&strm);
   }
+  {
+    struct stream strm = STREAM_INIT;
+    char c;
+    int i;
+
+    TEST_INT(open_mmap_stream(&strm, filename), 0);
+    TEST_INT(strm.type, STREAM_MMAP);
+
+    c = stream_getc(&strm);
+    TEST_INT(c, 't');
+
+    c = stream_getc(&strm);
+    TEST_INT(c, 'h');
+
+    c = stream_ungetc(&strm);
+    TEST_INT(c, 't');
+
+    c = stream_getc(&strm);
+    TEST_INT(c, 'h');
+
+    for (i = 0; i < 11; i++) {
+      c = stream_getc(&strm);
+    }
+    TEST_INT(c, '\n');
+
+    c = stream_getc(&strm);
+    TEST_INT(c, '\0');
+
+    /* the end was not read, so ungetting it does not move */
+    c = stream_ungetc(&strm);
+    TEST_INT(c, '\n');
+    c = stream_getc(&strm);
+    TEST_INT(c, '\0');
+
+    /* no lookahead limit */
+    for (i = 0; i < 13; i++) {
+      c = stream_ungetc(&strm);
+    }
+    TEST_INT(c, 't');
+
+    c = stream_getc(&strm);
+    TEST_INT(c, 'h');
+
+    close_stream(&strm);
+  }
+  {
+    struct stream strm = STREAM_INIT;
+    char c = '\0';
+    int i;
+
+    /* chunked reads through a descriptor as for pipes and stdin */
+    TEST_INT(open_fd_stream(&strm, open(bigfile, O_RDONLY)), 0);
+
+    for (i = 0; i < STREAM_CHUNK_SIZE + 10; i++) {
+      c = stream_getc(&strm);
+    }
+    TEST_INT(c, 'a' + (STREAM_CHUNK_SIZE + 9) % 26);
+
+    /* push back across the chunk boundary */
+    for (i = 0; i < 40; i++) {
+      c = stream_ungetc(&strm);
+    }
+    TEST_INT(c, 'a' + (STREAM_CHUNK_SIZE - 31) % 26);
+
+    for (i = 0; i < 130; i++) {
+      c = stream_getc(&strm);
+    }
+    TEST_INT(c, 'a' + (STREAM_CHUNK_SIZE + 99) % 26);
+
+    c = stream_getc(&strm);
+    TEST_INT(c, '\0');
+
+    close(strm.fd);
+    close_stream(&strm);
+  }
 #if 0
   {
     const char src[] = " abcd 12.3 /* ... */  \n this is stream?";
@@ -0,0 +1,141 @@
+#include "intern.h"
+#include "symbol.h"
+#include "unit_test.h"
+#include <stdio.h>
+
+int main()
+{
+	{
+		struct interner *names = new_interner();
+		struct symbol_table *table = new_symbol_table();
+		const char *x = intern(names, "x", 1);
+		struct symbol *sym = NULL;
+
+		TEST(lookup_symbol(table, x) == NULL);
+		TEST_INT((int) symbol_count(table), 0);
+
+		sym = add_symbol(table, x, SYM_VAR);
+		TEST(sym != NULL);
+		TEST_STR(symbol_name(sym), "x");
+		TEST(lookup_symbol(table, x) == sym);
+		/* the same name gives the same symbol */
+		TEST(add_symbol(table, x, SYM_VAR) == sym);
+		TEST_INT((int) symbol_count(table), 1);
+
+		free_symbol_table(table);
+		free_interner(names);
+	}
+	{
+		/* more names than the initial slots make the table grow */
+		struct interner *names = new_interner();
+		struct symbol_table *table = new_symbol_table();
+		const unsigned long initial = symbol_capacity(table);
+		enum { N_NAMES = 10000 };
+		static struct symbol *syms[N_NAMES];
+		char buf[32];
+		int found = 0;
+		int i;
+
+		for (i = 0; i < N_NAMES; i++) {
+			sprintf(buf, "name%d", i);
+			syms[i] = add_symbol(table, intern(names, buf, strlen(buf)), SYM_VAR);
+		}
+		TEST_INT((int) symbol_count(table), N_NAMES);
+		TEST(symbol_capacity(table) > initial);
+		/* a power of two at most half full */
+		TEST_INT((int) (symbol_capacity(table) & (symbol_capacity(table) - 1)), 0);
+		TEST(symbol_count(table) * 2 <= symbol_capacity(table));
+
+		/* symbols do not move when the table grows */
+		for (i = 0; i < N_NAMES; i++) {
+			sprintf(buf, "name%d", i);
+			found += lookup_symbol(table, intern(names, buf, strlen(buf))) == syms[i];
+		}
+		TEST_INT(found, N_NAMES);
+
+		free_symbol_table(table);
+		free_interner(names);
+	}
+
+	{
+		struct interner *names = new_interner();
+		struct symbol_table *table = new_symbol_table();
+		const char *i = intern(names, "i", 1);
+		const char *n = intern(names, "n", 1);
+		struct symbol *file_i = NULL;
+		struct symbol *fn_i = NULL;
+		struct symbol *block_i = NULL;
+		struct symbol *block_n = NULL;
+
+		TEST_INT(scope_depth(table), 0);
+		file_i = define_symbol(table, i, SYM_VAR);
+		TEST(lookup_symbol(table, i) == file_i);
+
+		/* an inner definition shadows the outer one */
+		TEST_INT(open_scope(table), 1);
+		TEST_INT(scope_depth(table), 1);
+		fn_i = define_symbol(table, i, SYM_VAR);
+		TEST(fn_i != NULL && fn_i != file_i);
+		TEST(lookup_symbol(table, i) == fn_i);
+		/* defining again in the same scope gives the same symbol */
+		TEST(define_symbol(table, i, SYM_VAR) == fn_i);
+
+		TEST_INT(open_scope(table), 1);
+		block_i = define_symbol(table, i, SYM_VAR);
+		block_n = define_symbol(table, n, SYM_VAR);
+		TEST(lookup_symbol(table, i) == block_i);
+		TEST(lookup_symbol(table, n) == block_n);
+
+		/* closing a scope restores what it shadowed */
+		close_scope(table);
+		TEST_INT(scope_depth(table), 1);
+		TEST(lookup_symbol(table, i) == fn_i);
+		TEST(lookup_symbol(table, n) == NULL);
+
+		close_scope(table);
+		TEST_INT(scope_depth(table), 0);
+		TEST(lookup_symbol(table, i) == file_i);
+
+		/* the file scope is never closed */
+		close_scope(table);
+		TEST_INT(scope_depth(table), 0);
+		TEST(lookup_symbol(table, i) == file_i);
+
+		/* closed symbols stay valid */
+		TEST_STR(symbol_name(block_n), "n");
+
+		free_symbol_table(table);
+		free_interner(names);
+	}
+	{
+		/* scopes deeper than the initial scope stack */
+		struct interner *names = new_interner();
+		struct symbol_table *table = new_symbol_table();
+		const char *x = intern(names, "x", 1);
+		enum { DEPTH = 100 };
+		static struct symbol *syms[DEPTH];
+		int restored = 0;
+		int d;
+
+		for (d = 0; d < DEPTH; d++) {
+			open_scope(table);
+			syms[d] = define_symbol(table, x, SYM_VAR);
+		}
+		TEST_INT(scope_depth(table), DEPTH);
+		for (d = DEPTH - 1; d > 0; d--) {
+			close_scope(table);
+			restored += lookup_symbol(table, x) == syms[d - 1];
+		}
+		TEST_INT(restored, DEPTH - 1);
+		close_scope(table);
+		TEST(lookup_symbol(table, x) == NULL);
+
+		free_symbol_table(table);
+		free_interner(names);
+	}
+
+	printf("%s: %d/%d/%d: (FAIL/PASS/TOTAL)\n", __FILE__,
+		TestGetFailCount(), TestGetPassCount(), TestGetTotalCount());
+
+	return 0;
+}